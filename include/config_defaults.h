@@ -0,0 +1,91 @@
+#ifndef CONFIG_DEFAULTS_H
+#define CONFIG_DEFAULTS_H
+
+// Defaults for the settings added to config.h over time, such that an existing config.h keeps working.
+// Included right after config.h, see README.md in this directory for the meaning of each setting.
+
+// ADC sampling, replacing the fixed IVT490_ADC_SAMPLING_INTERVAL and IVT490_ADC_FILTER_WINDOW_COUNT
+#if defined(IVT490_ADC_SAMPLING_INTERVAL) && !defined(IVT490_ADC_SAMPLING_MIN_INTERVAL)
+#warning "IVT490_ADC_SAMPLING_INTERVAL is replaced by IVT490_ADC_SAMPLING_MIN_INTERVAL and IVT490_ADC_SAMPLING_MAX_INTERVAL, please update config.h"
+#define IVT490_ADC_SAMPLING_MIN_INTERVAL IVT490_ADC_SAMPLING_INTERVAL
+#endif
+
+#if !defined(IVT490_ADC_SAMPLING_MIN_INTERVAL)
+#error "IVT490_ADC_SAMPLING_MIN_INTERVAL is not defined in config.h"
+#endif
+
+#ifndef IVT490_ADC_SAMPLING_MAX_INTERVAL
+#define IVT490_ADC_SAMPLING_MAX_INTERVAL (30 * IVT490_ADC_SAMPLING_MIN_INTERVAL)
+#endif
+
+#if defined(IVT490_ADC_FILTER_WINDOW_COUNT) && !defined(IVT490_ADC_FILTER_TIME_CONSTANT)
+#warning "IVT490_ADC_FILTER_WINDOW_COUNT is replaced by IVT490_ADC_FILTER_TIME_CONSTANT, please update config.h"
+// A moving average over a window lags about half the window
+#define IVT490_ADC_FILTER_TIME_CONSTANT (IVT490_ADC_FILTER_WINDOW_COUNT * IVT490_ADC_SAMPLING_MIN_INTERVAL / 2)
+#endif
+
+#if !defined(IVT490_ADC_FILTER_TIME_CONSTANT)
+#error "IVT490_ADC_FILTER_TIME_CONSTANT is not defined in config.h"
+#endif
+
+#ifndef IVT490_ADC_FILTER_FAST_TIME_CONSTANT
+#define IVT490_ADC_FILTER_FAST_TIME_CONSTANT (IVT490_ADC_FILTER_TIME_CONSTANT / 10)
+#endif
+
+#ifndef IVT490_ADC_INNOVATION_THRESHOLD
+#define IVT490_ADC_INNOVATION_THRESHOLD 0.5
+#endif
+
+// Publishing
+#ifndef GENERAL_PUBLISH_CHUNK_SIZE
+#define GENERAL_PUBLISH_CHUNK_SIZE 4
+#endif
+
+#ifndef GENERAL_INDIVIDUAL_TOPICS_REFRESH_COUNT
+#define GENERAL_INDIVIDUAL_TOPICS_REFRESH_COUNT 30
+#endif
+
+#ifndef GENERAL_SNAPSHOT_INTERVAL
+#define GENERAL_SNAPSHOT_INTERVAL 3600000
+#endif
+
+#ifndef GENERAL_NTP_SERVER
+#define GENERAL_NTP_SERVER "pool.ntp.org"
+#endif
+
+// Buffers
+#ifndef GENERAL_MQTT_TOPIC_BUFFER_SIZE
+#define GENERAL_MQTT_TOPIC_BUFFER_SIZE 128
+#endif
+
+#ifndef GENERAL_MQTT_PAYLOAD_BUFFER_SIZE
+#define GENERAL_MQTT_PAYLOAD_BUFFER_SIZE 4096
+#endif
+
+#ifndef GENERAL_JSON_DOCUMENT_SIZE
+#define GENERAL_JSON_DOCUMENT_SIZE 4096
+#endif
+
+#ifndef IVT490_SERIAL_BUFFER_SIZE
+#define IVT490_SERIAL_BUFFER_SIZE 256
+#endif
+
+// Accounting and anomaly detection
+#ifndef IVT490_ELECTRICITY_SUPPLEMENT_POWER
+#define IVT490_ELECTRICITY_SUPPLEMENT_POWER 9.0
+#endif
+
+#ifndef IVT490_ANOMALY_DEVIATION_THRESHOLD
+#define IVT490_ANOMALY_DEVIATION_THRESHOLD 6.0
+#endif
+
+#ifndef IVT490_GT6_LIMIT
+#define IVT490_GT6_LIMIT 110.0
+#endif
+
+// Metrics
+#if defined(GENERAL_METRICS_PORT) && !defined(GENERAL_METRICS_POLL_INTERVAL)
+#define GENERAL_METRICS_POLL_INTERVAL 50
+#endif
+
+#endif
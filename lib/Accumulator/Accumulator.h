@@ -0,0 +1,233 @@
+#ifndef ACCUMULATOR_H
+#define ACCUMULATOR_H
+
+#include <algorithm>
+#include <math.h>
+
+#include "IVT490State.h"
+
+namespace Accumulator
+{
+    // Running totals of the operation of the heatpump over some period of time
+    struct Aggregate
+    {
+        float compressor_runtime = 0;    // hours
+        unsigned long compressor_starts = 0;
+        float P1_runtime = 0;            // hours
+        float fan_runtime = 0;           // hours
+        float defrost_runtime = 0;       // hours
+        float supplement_energy = 0;     // kWh
+        float heating_degree_hours = 0;  // degree hours below DEGREE_HOURS_BASE
+        float GT6_min = NAN;             // degrees Celsius
+        float GT6_max = NAN;             // degrees Celsius
+
+        void add(const Aggregate &other)
+        {
+            this->compressor_runtime += other.compressor_runtime;
+            this->compressor_starts += other.compressor_starts;
+            this->P1_runtime += other.P1_runtime;
+            this->fan_runtime += other.fan_runtime;
+            this->defrost_runtime += other.defrost_runtime;
+            this->supplement_energy += other.supplement_energy;
+            this->heating_degree_hours += other.heating_degree_hours;
+            this->GT6_min = fmin(this->GT6_min, other.GT6_min);
+            this->GT6_max = fmax(this->GT6_max, other.GT6_max);
+        }
+
+        template <typename object_t>
+        void serialize(object_t obj) const
+        {
+            obj["compressor_runtime"] = this->compressor_runtime;
+            obj["compressor_starts"] = this->compressor_starts;
+            obj["P1_runtime"] = this->P1_runtime;
+            obj["fan_runtime"] = this->fan_runtime;
+            obj["defrost_runtime"] = this->defrost_runtime;
+            obj["supplement_energy"] = this->supplement_energy;
+            obj["heating_degree_hours"] = this->heating_degree_hours;
+            obj["GT6_min"] = this->GT6_min;
+            obj["GT6_max"] = this->GT6_max;
+        }
+    };
+
+    // The Accumulator integrates the parsed state sentence by sentence into a running total as well as
+    // into rings of hourly and daily aggregates, using constant memory and constant work per sentence.
+    // Hours and days are counted from the first sentence, not by wall clock, and carry on from restored
+    // rings. The state of a sentence is considered to be held until the next one, an interval spanning the
+    // end of an hour is split between the two hours.
+
+    template <unsigned int HOURS, unsigned int DAYS>
+    class Accumulator
+    {
+    public:
+        static constexpr float DEGREE_HOURS_BASE = 17.0;      // degrees Celsius
+        static const unsigned long MAX_GAP = 10 * 60 * 1000; // milliseconds
+        static const unsigned long HOUR = 3600000;           // milliseconds
+
+        // The hourly and daily aggregates and the position in them, kept as one plain struct to be persisted
+        struct Rings
+        {
+            Aggregate hourly[HOURS];
+            Aggregate daily[DAYS];
+            unsigned int hour = 0;
+            unsigned int day = 0;
+            unsigned int hours_in_day = 0;
+            unsigned long elapsed = 0; // milliseconds into the current hour
+        };
+
+        void set_supplement_power(float power)
+        {
+            this->supplement_power = power;
+        }
+
+        void input(const IVT490::IVT490State &state, unsigned long now)
+        {
+            if (this->has_previous)
+            {
+                // Do not integrate over gaps in the serial output, but keep the buckets in step with time
+                auto dt = now - this->previous_time;
+                this->advance(dt, dt <= MAX_GAP);
+            }
+
+            // Events are attributed to the bucket in which the sentence reporting them is received
+            Aggregate events;
+            events.compressor_starts = this->has_previous && state.compressor && !this->previous.compressor;
+            events.GT6_min = state.GT6;
+            events.GT6_max = state.GT6;
+            this->add(events);
+
+            this->previous = state;
+            this->previous_time = now;
+            this->has_previous = true;
+        }
+
+        const Aggregate &get_total() const
+        {
+            return this->total;
+        }
+
+        void set_total(const Aggregate &total)
+        {
+            this->total = total;
+        }
+
+        const Rings &get_rings() const
+        {
+            return this->rings;
+        }
+
+        // Restores the rings, to be followed by skip() for the time passed since they were saved. Nothing is
+        // integrated up to the next sentence.
+        void set_rings(const Rings &rings)
+        {
+            this->rings = rings;
+            this->has_previous = false;
+        }
+
+        // Moves the buckets forward by duration, as over a gap in the serial output
+        void skip(unsigned long duration)
+        {
+            this->advance(std::min(duration, (DAYS + 1) * 24 * HOUR), false);
+        }
+
+        // Aggregate of the current hour (ago = 0) or of one of the previous hours
+        const Aggregate &get_hour(unsigned int ago) const
+        {
+            return this->rings.hourly[(this->rings.hour + HOURS - ago % HOURS) % HOURS];
+        }
+
+        // Aggregate of the current day (ago = 0) or of one of the previous days
+        const Aggregate &get_day(unsigned int ago) const
+        {
+            return this->rings.daily[(this->rings.day + DAYS - ago % DAYS) % DAYS];
+        }
+
+        template <typename document_t>
+        void serialize(document_t &doc) const
+        {
+            this->total.serialize(doc.createNestedObject("total"));
+            this->get_hour(0).serialize(doc.createNestedObject("hour"));
+            this->get_day(0).serialize(doc.createNestedObject("day"));
+
+            Aggregate last_hours;
+            for (auto &aggregate : this->rings.hourly)
+            {
+                last_hours.add(aggregate);
+            }
+            last_hours.serialize(doc.createNestedObject("last_hours"));
+
+            Aggregate last_days;
+            for (auto &aggregate : this->rings.daily)
+            {
+                last_days.add(aggregate);
+            }
+            last_days.serialize(doc.createNestedObject("last_days"));
+        }
+
+    private:
+        void advance(unsigned long dt, bool integrate)
+        {
+            auto &rings = this->rings;
+            while (dt > 0)
+            {
+                auto step = std::min(dt, HOUR - rings.elapsed);
+                if (integrate)
+                {
+                    this->hold(step / (float)HOUR);
+                }
+
+                dt -= step;
+                rings.elapsed += step;
+                if (rings.elapsed == HOUR)
+                {
+                    this->next_hour();
+                }
+            }
+        }
+
+        void next_hour()
+        {
+            auto &rings = this->rings;
+            rings.elapsed = 0;
+            rings.hour = (rings.hour + 1) % HOURS;
+            rings.hourly[rings.hour] = Aggregate();
+
+            if (++rings.hours_in_day == 24)
+            {
+                rings.hours_in_day = 0;
+                rings.day = (rings.day + 1) % DAYS;
+                rings.daily[rings.day] = Aggregate();
+            }
+        }
+
+        // Integrates the previous state over the given number of hours
+        void hold(float hours)
+        {
+            Aggregate step;
+            step.compressor_runtime = this->previous.compressor * hours;
+            step.P1_runtime = this->previous.P1 * hours;
+            step.fan_runtime = this->previous.fan * hours;
+            step.defrost_runtime = this->previous.GP3 * hours;
+            step.supplement_energy = this->previous.electricity_supplement / 100 * this->supplement_power * hours;
+            step.heating_degree_hours = std::max(0.0f, DEGREE_HOURS_BASE - this->previous.GT2_sensor) * hours;
+            this->add(step);
+        }
+
+        void add(const Aggregate &step)
+        {
+            this->total.add(step);
+            this->rings.hourly[this->rings.hour].add(step);
+            this->rings.daily[this->rings.day].add(step);
+        }
+
+        float supplement_power = 0; // kW
+
+        IVT490::IVT490State previous = {};
+        unsigned long previous_time = 0;
+        bool has_previous = false;
+
+        Aggregate total;
+        Rings rings;
+    };
+
+}
+#endif
\ No newline at end of file
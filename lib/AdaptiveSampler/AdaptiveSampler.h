@@ -0,0 +1,71 @@
+#ifndef ADAPTIVE_SAMPLER_H
+#define ADAPTIVE_SAMPLER_H
+
+#include <algorithm>
+#include <math.h>
+
+namespace AdaptiveSampler
+{
+    // The AdaptiveSampler decides when the next sample is due based on the innovation, i.e. the difference
+    // between the latest sample and the filtered value. While the signal is stable, the interval backs off
+    // towards MAX_INTERVAL. When the innovation exceeds the threshold, sampling bursts at MIN_INTERVAL and,
+    // if the innovation persists, the change is considered real and should be tracked more closely.
+
+    template <unsigned long MIN_INTERVAL, unsigned long MAX_INTERVAL>
+    class AdaptiveSampler
+    {
+    public:
+        AdaptiveSampler(float threshold)
+        {
+            this->threshold = threshold;
+        }
+
+        bool is_due(unsigned long now) const
+        {
+            return this->samples == 0 || now - this->last_sample >= this->interval;
+        }
+
+        void input(float innovation, unsigned long now)
+        {
+            this->last_sample = now;
+            this->samples++;
+
+            if (fabsf(innovation) > this->threshold)
+            {
+                this->interval = MIN_INTERVAL;
+                this->exceedances++;
+            }
+            else
+            {
+                this->interval = std::min(MAX_INTERVAL, 2 * this->interval);
+                this->exceedances = 0;
+            }
+        }
+
+        bool is_tracking() const
+        {
+            return this->exceedances >= TRACKING_SAMPLES;
+        }
+
+        unsigned long get_interval() const
+        {
+            return this->interval;
+        }
+
+        unsigned long get_samples() const
+        {
+            return this->samples;
+        }
+
+    private:
+        static const unsigned int TRACKING_SAMPLES = 3;
+
+        float threshold;
+        unsigned long interval = MIN_INTERVAL;
+        unsigned long last_sample = 0;
+        unsigned long samples = 0;
+        unsigned int exceedances = 0;
+    };
+
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,253 @@
+#ifndef ANOMALY_DETECTOR_H
+#define ANOMALY_DETECTOR_H
+
+#include <algorithm>
+#include <math.h>
+
+#include "IVT490State.h"
+
+namespace AnomalyDetector
+{
+    // Exponentially weighted mean and variance of a signal, parameterized by a time constant rather than
+    // a weight per sample, such that the statistics cover the same window regardless of the sample spacing.
+    // Intervals between samples are capped at MAX_INTERVAL, such that a signal which is not fed for a while
+    // is not forgotten at once.
+    class EWStatistics
+    {
+    public:
+        static constexpr unsigned long MAX_INTERVAL = 5 * 60 * 1000; // milliseconds
+
+        EWStatistics(float time_constant = 1800000)
+        {
+            this->time_constant = time_constant;
+        }
+
+        void set_time_constant(float time_constant)
+        {
+            this->time_constant = time_constant;
+        }
+
+        // Number of standard deviations between value and the mean, zero until warmed up for one time constant
+        float score(float value) const
+        {
+            if (this->elapsed < this->time_constant)
+            {
+                return 0;
+            }
+
+            return (value - this->mean) / std::max(MIN_STANDARD_DEVIATION, sqrtf(this->variance));
+        }
+
+        void input(float value, unsigned long now)
+        {
+            if (this->samples++ == 0)
+            {
+                this->mean = value;
+                this->last_input = now;
+                return;
+            }
+
+            auto dt = std::min(now - this->last_input, MAX_INTERVAL);
+            this->elapsed += dt;
+
+            auto alpha = 1 - expf(-(float)dt / this->time_constant);
+            auto difference = value - this->mean;
+            auto increment = alpha * difference;
+            this->mean += increment;
+            this->variance = (1 - alpha) * (this->variance + difference * increment);
+            this->last_input = now;
+        }
+
+        float get_mean() const
+        {
+            return this->mean;
+        }
+
+        float get_variance() const
+        {
+            return this->variance;
+        }
+
+    private:
+        static constexpr float MIN_STANDARD_DEVIATION = 0.2; // Resolution of the serial output is 0.1
+
+        float time_constant;
+        float mean = 0;
+        float variance = 0;
+        unsigned long last_input = 0;
+        unsigned long elapsed = 0; // milliseconds of (capped) intervals seen
+        unsigned long samples = 0;
+    };
+
+    // The AnomalyDetector checks every ADC sample and every serial sentence for signs of a malfunction and
+    // calls the handler as soon as a condition becomes active, and again when it clears. Memory use and the
+    // work per sample are fixed.
+    //
+    // Temperatures driven by the compressor (feed, heating water and hot gas) step whenever it starts or
+    // stops. These are only checked once the compressor has been in the same state for SETTLING_TIME, against
+    // statistics kept separately for when the compressor is running and when it is not.
+
+    class AnomalyDetector
+    {
+    public:
+        typedef void (*Handler)(const char *channel, const char *kind, bool active, float value, float expected);
+
+        static const unsigned long SETTLING_TIME = 15 * 60 * 1000; // milliseconds
+        static const unsigned long GT2_SENSOR_TIME_CONSTANT = 30 * 60 * 1000; // milliseconds
+        static const unsigned long CHANNEL_TIME_CONSTANT = 60 * 60 * 1000;    // milliseconds
+
+        AnomalyDetector() : GT2_sensor_statistics(GT2_SENSOR_TIME_CONSTANT)
+        {
+            for (auto &statistics : this->statistics)
+            {
+                statistics[0].set_time_constant(CHANNEL_TIME_CONSTANT);
+                statistics[1].set_time_constant(CHANNEL_TIME_CONSTANT);
+            }
+        }
+
+        void on_anomaly(Handler handler)
+        {
+            this->handler = handler;
+        }
+
+        void set_deviation_threshold(float threshold)
+        {
+            this->deviation_threshold = threshold;
+        }
+
+        void set_GT6_limit(float limit)
+        {
+            this->GT6_limit = limit;
+        }
+
+        unsigned long get_events() const
+        {
+            return this->events;
+        }
+
+        void input_GT2_sensor(float value, unsigned long now)
+        {
+            // The ends of the NTC table are only reached by an open or shorted sensor
+            this->check(GT2_SENSOR_FAULT, value <= -40 || value >= 90, "GT2_sensor", "fault", value, NAN);
+            this->check_deviation(GT2_SENSOR_DEVIATION, this->GT2_sensor_statistics, "GT2_sensor", value, now);
+        }
+
+        void input(const IVT490::IVT490State &state, float emulated_GT2, unsigned long now)
+        {
+            if (!this->has_compressor_state || state.compressor != this->compressor)
+            {
+                this->compressor = state.compressor;
+                this->compressor_changed = now;
+                this->has_compressor_state = true;
+            }
+            auto compressor_is_settled = now - this->compressor_changed >= SETTLING_TIME;
+
+            for (int i = 0; i < NUMBER_OF_CHANNELS; i++)
+            {
+                auto &channel = CHANNELS[i];
+
+                if (channel.follows_compressor && !compressor_is_settled)
+                {
+                    continue;
+                }
+
+                auto &statistics = this->statistics[i][channel.follows_compressor && state.compressor];
+                this->check_deviation(CHANNEL_DEVIATION + i, statistics, channel.name, state.*channel.member, now);
+            }
+
+            this->check(GT6_LIMIT, state.GT6 > this->GT6_limit, "GT6", "limit", state.GT6, this->GT6_limit);
+
+            // The emulator correction needs a few sentences to settle after a change
+            this->GT2_mismatches = fabsf(state.GT2_heatpump - emulated_GT2) > EMULATOR_TOLERANCE ? this->GT2_mismatches + 1 : 0;
+            this->check(GT2_MISMATCH, this->GT2_mismatches >= MISMATCH_SENTENCES, "GT2_heatpump", "mismatch", state.GT2_heatpump, emulated_GT2);
+
+            this->check(GP1_TRIPPED, state.GP1, "GP1", "tripped", state.GP1, 0);
+            this->check(GP2_TRIPPED, state.GP2, "GP2", "tripped", state.GP2, 0);
+            this->check(ALARM, state.alarm, "alarm", "alarm", state.alarm, 0);
+
+            // The shunt should not need to move in one direction for very long
+            this->SV1_open_sentences = state.SV1_open ? this->SV1_open_sentences + 1 : 0;
+            this->SV1_close_sentences = state.SV1_close ? this->SV1_close_sentences + 1 : 0;
+            this->check(SV1_OPEN_STUCK, this->SV1_open_sentences >= STUCK_SENTENCES, "SV1_open", "stuck", this->SV1_open_sentences, STUCK_SENTENCES);
+            this->check(SV1_CLOSE_STUCK, this->SV1_close_sentences >= STUCK_SENTENCES, "SV1_close", "stuck", this->SV1_close_sentences, STUCK_SENTENCES);
+        }
+
+    private:
+        struct Channel
+        {
+            const char *name;
+            float IVT490::IVT490State::*member;
+            bool follows_compressor;
+        };
+
+        // Tap water temperatures are left out as they change with every draw of hot water
+        static constexpr Channel CHANNELS[] = {
+            {"GT1", &IVT490::IVT490State::GT1, true},
+            {"GT3_3", &IVT490::IVT490State::GT3_3, true},
+            {"GT5", &IVT490::IVT490State::GT5, false},
+            {"GT6", &IVT490::IVT490State::GT6, true},
+        };
+        static const int NUMBER_OF_CHANNELS = sizeof(CHANNELS) / sizeof(Channel);
+
+        enum Condition
+        {
+            GT2_SENSOR_FAULT,
+            GT2_SENSOR_DEVIATION,
+            CHANNEL_DEVIATION, // One per channel, in the order of CHANNELS
+            GT6_LIMIT = CHANNEL_DEVIATION + NUMBER_OF_CHANNELS,
+            GT2_MISMATCH,
+            GP1_TRIPPED,
+            GP2_TRIPPED,
+            ALARM,
+            SV1_OPEN_STUCK,
+            SV1_CLOSE_STUCK,
+            NUMBER_OF_CONDITIONS
+        };
+
+        static constexpr float EMULATOR_TOLERANCE = 1.0; // degrees Celsius
+        static const unsigned int MISMATCH_SENTENCES = 5;
+        static const unsigned int STUCK_SENTENCES = 30;
+
+        void check(int condition, bool anomalous, const char *channel, const char *kind, float value, float expected)
+        {
+            if (anomalous == this->active[condition])
+            {
+                return;
+            }
+
+            this->active[condition] = anomalous;
+            this->events++;
+
+            if (this->handler)
+            {
+                this->handler(channel, kind, anomalous, value, expected);
+            }
+        }
+
+        void check_deviation(int condition, EWStatistics &statistics, const char *channel, float value, unsigned long now)
+        {
+            auto score = statistics.score(value);
+            this->check(condition, fabsf(score) > this->deviation_threshold, channel, "deviation", value, statistics.get_mean());
+            statistics.input(value, now);
+        }
+
+        Handler handler = nullptr;
+        float deviation_threshold = 6.0;
+        float GT6_limit = 120.0;
+
+        EWStatistics GT2_sensor_statistics;
+        EWStatistics statistics[NUMBER_OF_CHANNELS][2]; // Indexed by the compressor state, if followed
+        bool active[NUMBER_OF_CONDITIONS] = {};
+
+        bool compressor = false;
+        bool has_compressor_state = false;
+        unsigned long compressor_changed = 0;
+
+        unsigned int GT2_mismatches = 0;
+        unsigned int SV1_open_sentences = 0;
+        unsigned int SV1_close_sentences = 0;
+        unsigned long events = 0;
+    };
+
+}
+#endif
\ No newline at end of file
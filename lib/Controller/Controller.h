@@ -0,0 +1,238 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <math.h>
+#include <tuple>
+#include <utility>
+
+#include "HeatingCurve.h"
+#include "IVT490State.h"
+#include "Logging.h"
+
+namespace Controller
+{
+    // The Controller decides the control value, i.e. the outdoor temperature to emulate towards the heatpump,
+    // and whether to enable vacation mode, from the setpoints received over MQTT and the heating curve learned
+    // from the serial output. Setpoints expire VALIDITY milliseconds after they were last received. The clock
+    // is injected to allow for running under a virtual clock.
+
+    template <unsigned int VALIDITY>
+    class Controller
+    {
+    public:
+        typedef unsigned long (*Clock)();
+
+        Controller(Clock clock)
+        {
+            this->clock = clock;
+        }
+
+        void set_outdoor_temperature(float temperature)
+        {
+            this->outdoor_temperature = temperature;
+        }
+
+        void set_outdoor_temperature_offset(float offset)
+        {
+            this->outdoor_temperature_offset = offset;
+            this->outdoor_temperature_offset_last_updated = this->clock();
+        }
+
+        float get_outdoor_temperature_offset()
+        {
+            return this->outdoor_temperature_offset;
+        }
+
+        bool outdoor_temperature_offset_is_valid()
+        {
+            return (this->clock() - this->outdoor_temperature_offset_last_updated <= VALIDITY && this->outdoor_temperature_offset_last_updated != 0 && !isnan(this->outdoor_temperature_offset));
+        }
+
+        void set_summer_temperature_limit(float temperature)
+        {
+            this->summer_temperature_limit = temperature;
+        }
+
+        void set_indoor_temperature(float temperature)
+        {
+            this->indoor_temperature = temperature;
+            this->indoor_temperature_last_updated = this->clock();
+        }
+
+        void set_indoor_temperature_target(float target)
+        {
+            this->indoor_temperature_target = target;
+        }
+
+        float get_indoor_temperature_target()
+        {
+            return this->indoor_temperature_target;
+        }
+
+        void set_indoor_temperature_weight(float weight)
+        {
+            this->indoor_temperature_weight = weight;
+        }
+
+        float get_indoor_temperature()
+        {
+            return this->indoor_temperature;
+        }
+
+        bool indoor_temperature_is_valid()
+        {
+            return (
+                this->clock() - this->indoor_temperature_last_updated <= VALIDITY && this->indoor_temperature_last_updated != 0 && !isnan(this->indoor_temperature));
+        }
+
+        void set_feed_temperature_target(float temperature)
+        {
+            this->feed_temperature_target = temperature;
+            this->feed_temperature_target_last_updated = this->clock();
+        }
+
+        void set_heating_curve_slope(float slope)
+        {
+            this->heating_curve.reset(slope);
+        }
+
+        void update_heating_curve(const IVT490::IVT490State &state)
+        {
+            if (state.vacation)
+            {
+                // Vacation mode lowers GT1_target independently of the heating curve
+                return;
+            }
+
+            this->heating_curve.learn(state.GT2_heatpump, state.GT1_target, state.GT1_LL, state.GT1_UL);
+        }
+
+        HeatingCurve::HeatingCurve &get_heating_curve()
+        {
+            return this->heating_curve;
+        }
+
+        float get_feed_temperature_target()
+        {
+            return this->feed_temperature_target;
+        }
+
+        bool feed_temperature_target_is_valid()
+        {
+            return (this->clock() - this->feed_temperature_target_last_updated <= VALIDITY && this->feed_temperature_target_last_updated != 0 && !isnan(this->feed_temperature_target));
+        }
+
+        std::pair<float, bool> vacation_mode_logic(float control_value)
+        {
+            if (this->summer_temperature_limit > 0 && this->outdoor_temperature < 1.0 && control_value >= this->summer_temperature_limit - 1)
+            {
+                // We want to have a lower feed temperature than what can be achieved without hitting the summer mode (i.e P1 stops),
+                // at the same time as the outdoor temperature is approaching freezing... Not good!
+                // The best we can do is to:
+                // * Ensure the faked outdoor temperature (i.e. control value) is lower than the summer temperature limit
+                // * Enable vacation mode to lower the feed temperature without risking that P1 stops
+                LOG_WARN("Controller: Control value adjusted and vacation mode enabled to avoid P1 stopping during freezing temperatures!");
+                return std::make_pair(this->summer_temperature_limit - 1.0, true);
+            }
+            else if (control_value > 21.0)
+            {
+                // We want to have a lower feed temperature than what the heatpump allows. Not sure if it actually helps to enable
+                // vacation mode here but it probably doesnt hurt.
+                return std::make_pair(control_value, true);
+            }
+
+            // Else, disable vacation mode and return the control_value untouched
+            return std::make_pair(control_value, false);
+        }
+
+        std::pair<float, bool> get_control_values()
+        {
+            float control_value;
+            bool vacation_mode = false;
+
+            if (feed_temperature_target_is_valid())
+            {
+                LOG_INFO("Controller: Feed temperature target is valid!");
+                LOG_INFO("Controller: Requested feed temperature:", this->feed_temperature_target);
+                control_value = this->heating_curve.outdoor_temperature(this->feed_temperature_target);
+
+                std::tie(control_value, vacation_mode) = this->vacation_mode_logic(control_value);
+
+                LOG_INFO("Controller: New control value:", control_value);
+                return std::make_pair(control_value, vacation_mode);
+            }
+
+            control_value = this->outdoor_temperature;
+
+            LOG_INFO("Controller: Base outdoor temperature:", control_value);
+
+            if (outdoor_temperature_offset_is_valid())
+            {
+                LOG_INFO("Controller: Outdoor temperature offset is valid!");
+                LOG_INFO("Controller: Outdoor temperature offset applied:", this->outdoor_temperature_offset);
+
+                control_value += this->outdoor_temperature_offset;
+            }
+
+            if (indoor_temperature_is_valid())
+            {
+                LOG_INFO("Controller: Indoor temperature is valid!");
+                LOG_INFO("Controller: Requested indoor temperature:", this->indoor_temperature_target);
+                LOG_INFO("Controller: Current indoor temperature:", this->indoor_temperature);
+                auto indoor_temperature_correction = this->indoor_temperature_weight * (this->indoor_temperature - this->indoor_temperature_target);
+                LOG_INFO("Controller: Correction applied:", indoor_temperature_correction);
+
+                control_value += indoor_temperature_correction;
+            }
+
+            std::tie(control_value, vacation_mode) = this->vacation_mode_logic(control_value);
+
+            LOG_INFO("Controller: New control value:", control_value);
+            LOG_INFO("Controller: Vacation mode:", vacation_mode);
+            return std::make_pair(control_value, vacation_mode);
+        }
+
+        template <typename document_t>
+        void serialize(document_t &doc)
+        {
+            doc["feed_temperature_target"]["value"] = this->feed_temperature_target;
+            doc["feed_temperature_target"]["valid"] = this->feed_temperature_target_is_valid();
+
+            doc["indoor_temperature_feedback"]["value"] = this->indoor_temperature;
+            doc["indoor_temperature_feedback"]["valid"] = this->indoor_temperature_is_valid();
+
+            doc["outdoor_temperature_offset"]["value"] = this->outdoor_temperature_offset;
+            doc["outdoor_temperature_offset"]["valid"] = this->outdoor_temperature_offset_is_valid();
+
+            doc["indoor_temperature_target"]["value"] = this->indoor_temperature_target;
+            doc["indoor_temperature_weight"]["value"] = this->indoor_temperature_weight;
+
+            doc["heating_curve_samples"] = this->heating_curve.get_samples();
+
+            auto [control_value, vacation_mode] = this->get_control_values();
+            doc["control_value"] = control_value;
+            doc["vacation_mode"] = vacation_mode;
+        }
+
+    private:
+        Clock clock;
+
+        float outdoor_temperature = NAN;
+
+        float outdoor_temperature_offset = 0.0;
+        unsigned long outdoor_temperature_offset_last_updated = 0;
+
+        float indoor_temperature_target = 20.0;
+        float indoor_temperature_weight = 1.0;
+        float indoor_temperature = NAN;
+        unsigned long indoor_temperature_last_updated = 0;
+
+        float feed_temperature_target = NAN;
+        HeatingCurve::HeatingCurve heating_curve;
+        unsigned long feed_temperature_target_last_updated = 0;
+
+        float summer_temperature_limit = -1;
+    };
+
+}
+#endif
\ No newline at end of file
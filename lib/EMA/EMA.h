@@ -0,0 +1,62 @@
+#ifndef EMA_H
+#define EMA_H
+
+#include <math.h>
+
+namespace EMA
+{
+    // Exponential moving average parameterized by a time constant rather than a number of samples,
+    // such that the response stays the same regardless of the spacing between the samples
+    template <typename type_t>
+    class Filter
+    {
+    private:
+        type_t value = 0;
+        type_t time_constant;
+        unsigned long last_input = 0;
+        bool initialized = false;
+
+    public:
+        Filter(type_t time_constant)
+        {
+            this->time_constant = time_constant;
+        }
+
+        void set_time_constant(type_t time_constant)
+        {
+            this->time_constant = time_constant;
+        }
+
+        void input(type_t value, unsigned long now)
+        {
+            if (!this->initialized)
+            {
+                this->reset(value, now);
+                return;
+            }
+
+            type_t alpha = 1 - exp(-(type_t)(now - this->last_input) / this->time_constant);
+            this->value += alpha * (value - this->value);
+            this->last_input = now;
+        }
+
+        type_t output(void)
+        {
+            return this->value;
+        }
+
+        void reset(type_t value, unsigned long now)
+        {
+            this->value = value;
+            this->last_input = now;
+            this->initialized = true;
+        }
+
+        bool is_initialized(void)
+        {
+            return this->initialized;
+        }
+    };
+
+}
+#endif
\ No newline at end of file
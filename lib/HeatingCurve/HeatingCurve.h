@@ -0,0 +1,169 @@
+#ifndef HEATING_CURVE_H
+#define HEATING_CURVE_H
+
+#include <algorithm>
+#include <math.h>
+#include <utility>
+
+namespace HeatingCurve
+{
+    // The linear heating curve of the IVT490, i.e. the feed temperature at a given outdoor temperature
+    inline float heating_curve(float slope, float outdoor_temperature)
+    {
+        return 20 + (-0.16 * slope) * (outdoor_temperature - 20);
+    }
+
+    // The HeatingCurve models the actual heating curve of the IVT490, i.e. GT1_target as a function of
+    // GT2_heatpump, as a non-increasing table of feed temperatures at fixed outdoor temperatures. The table
+    // is seeded from the linear heating curve and then learned from the (GT2_heatpump, GT1_target) pairs
+    // reported in each serial sentence, thereby picking up breakpoints and parallel offsets.
+
+    class HeatingCurve
+    {
+    public:
+        static const int MIN_OUTDOOR_TEMPERATURE = -40;
+        static const int MAX_OUTDOOR_TEMPERATURE = 20;
+        static const int OUTDOOR_TEMPERATURE_STEP = 2;
+        static const int NUMBER_OF_POINTS = (MAX_OUTDOOR_TEMPERATURE - MIN_OUTDOOR_TEMPERATURE) / OUTDOOR_TEMPERATURE_STEP + 1;
+
+        void reset(float slope)
+        {
+            this->gradient = -0.16 * slope;
+            for (int i = 0; i < NUMBER_OF_POINTS; i++)
+            {
+                this->feed_temperatures[i] = heating_curve(slope, outdoor_temperature_at(i));
+            }
+            this->samples = 0;
+        }
+
+        // Returns false if nothing could be learned, i.e. if the feed temperature is clamped by the limits or
+        // the outdoor temperature is outside of the table
+        bool learn(float outdoor_temperature, float feed_temperature, float lower_limit, float upper_limit)
+        {
+            this->upper_limit = upper_limit;
+
+            // Clamped values says nothing about the shape of the curve
+            if (feed_temperature <= lower_limit + 0.05 || feed_temperature >= upper_limit - 0.05)
+            {
+                return false;
+            }
+
+            if (outdoor_temperature < MIN_OUTDOOR_TEMPERATURE || outdoor_temperature > MAX_OUTDOOR_TEMPERATURE)
+            {
+                return false;
+            }
+
+            auto [i, weight] = this->segment(outdoor_temperature);
+            auto error = feed_temperature - this->interpolate(outdoor_temperature);
+
+            // Distribute the error over the two surrounding points, using the same weights as the interpolation
+            this->feed_temperatures[i] += LEARNING_RATE * (1 - weight) * error;
+            this->feed_temperatures[i + 1] += LEARNING_RATE * weight * error;
+
+            // The updated points take precedence, should they have crossed each other they meet halfway
+            if (this->feed_temperatures[i + 1] > this->feed_temperatures[i])
+            {
+                this->feed_temperatures[i] = this->feed_temperatures[i + 1] = (this->feed_temperatures[i] + this->feed_temperatures[i + 1]) / 2;
+            }
+
+            // Restore monotonicity outwards from the updated segment
+            for (int j = i + 2; j < NUMBER_OF_POINTS; j++)
+            {
+                this->feed_temperatures[j] = std::min(this->feed_temperatures[j], this->feed_temperatures[j - 1]);
+            }
+            for (int j = i - 1; j >= 0; j--)
+            {
+                this->feed_temperatures[j] = std::max(this->feed_temperatures[j], this->feed_temperatures[j + 1]);
+            }
+
+            this->samples++;
+            return true;
+        }
+
+        // The outdoor temperature at which the heatpump targets the given feed temperature. A feed temperature
+        // above the upper limit (GT1_UL) can not be reached and is taken as the upper limit. Below the lower
+        // limit (GT1_LL), the curve is followed past the limit such that the caller can tell that the feed
+        // temperature is lower than what the heating curve allows.
+        float outdoor_temperature(float feed_temperature) const
+        {
+            if (!isnan(this->upper_limit))
+            {
+                feed_temperature = std::min(feed_temperature, this->upper_limit);
+            }
+
+            // Outside of the table, extrapolate using the seeded gradient
+            if (feed_temperature >= this->feed_temperatures[0])
+            {
+                return MIN_OUTDOOR_TEMPERATURE + (feed_temperature - this->feed_temperatures[0]) / this->gradient;
+            }
+
+            if (feed_temperature <= this->feed_temperatures[NUMBER_OF_POINTS - 1])
+            {
+                return MAX_OUTDOOR_TEMPERATURE + (feed_temperature - this->feed_temperatures[NUMBER_OF_POINTS - 1]) / this->gradient;
+            }
+
+            int i = 0;
+            while (this->feed_temperatures[i + 1] >= feed_temperature)
+            {
+                i++;
+            }
+
+            auto weight = (this->feed_temperatures[i] - feed_temperature) / (this->feed_temperatures[i] - this->feed_temperatures[i + 1]);
+            return outdoor_temperature_at(i) + weight * OUTDOOR_TEMPERATURE_STEP;
+        }
+
+        unsigned long get_samples() const
+        {
+            return this->samples;
+        }
+
+        const float *get_feed_temperatures() const
+        {
+            return this->feed_temperatures;
+        }
+
+        void set_feed_temperatures(const float *feed_temperatures, unsigned long samples)
+        {
+            std::copy(feed_temperatures, feed_temperatures + NUMBER_OF_POINTS, this->feed_temperatures);
+            this->samples = samples;
+        }
+
+    private:
+        static constexpr float LEARNING_RATE = 0.5;
+
+        static float outdoor_temperature_at(int i)
+        {
+            return MIN_OUTDOOR_TEMPERATURE + i * OUTDOOR_TEMPERATURE_STEP;
+        }
+
+        std::pair<int, float> segment(float outdoor_temperature) const
+        {
+            auto position = (outdoor_temperature - MIN_OUTDOOR_TEMPERATURE) / OUTDOOR_TEMPERATURE_STEP;
+            int i = std::max(0, std::min(NUMBER_OF_POINTS - 2, (int)floorf(position)));
+            return std::make_pair(i, position - i);
+        }
+
+        float interpolate(float outdoor_temperature) const
+        {
+            auto [i, weight] = this->segment(outdoor_temperature);
+
+            if (weight < 0)
+            {
+                return this->feed_temperatures[0] + (weight * OUTDOOR_TEMPERATURE_STEP) * this->gradient;
+            }
+            if (weight > 1)
+            {
+                return this->feed_temperatures[NUMBER_OF_POINTS - 1] + ((weight - 1) * OUTDOOR_TEMPERATURE_STEP) * this->gradient;
+            }
+
+            return (1 - weight) * this->feed_temperatures[i] + weight * this->feed_temperatures[i + 1];
+        }
+
+        float feed_temperatures[NUMBER_OF_POINTS];
+        float gradient = -0.16;
+        float upper_limit = NAN;
+        unsigned long samples = 0;
+    };
+
+}
+#endif
@@ -0,0 +1,96 @@
+#include "IVT490State.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Logging.h"
+
+namespace IVT490
+{
+    const FloatField IVT490State_float_fields[] = {
+        {"GT1", &IVT490State::GT1, 1, 0.1},
+        {"GT1_target", &IVT490State::GT1_target, 22, 0.1},
+        {"GT1_LLT", &IVT490State::GT1_LLT, 20, 0.1},
+        {"GT1_LL", &IVT490State::GT1_LL, 21, 0.1},
+        {"GT1_UL", &IVT490State::GT1_UL, 23, 0.1},
+        {"GT2_heatpump", &IVT490State::GT2_heatpump, 2, 0.1},
+        {"GT2_sensor", &IVT490State::GT2_sensor, -1, 1.0},
+        {"GT3_1", &IVT490State::GT3_1, 3, 0.1},
+        {"GT3_2", &IVT490State::GT3_2, 4, 0.1},
+        {"GT3_2_LL", &IVT490State::GT3_2_LL, 24, 0.1},
+        {"GT3_2_UL", &IVT490State::GT3_2_UL, 26, 0.1},
+        {"GT3_2_ULT", &IVT490State::GT3_2_ULT, 25, 0.1},
+        {"GT3_3", &IVT490State::GT3_3, 5, 0.1},
+        {"GT3_3_target", &IVT490State::GT3_3_target, 28, 0.1},
+        {"GT3_3_LL", &IVT490State::GT3_3_LL, 27, 0.1},
+        {"GT3_4", &IVT490State::GT3_4, 8, 0.1},
+        {"GT5", &IVT490State::GT5, 6, 0.1},
+        {"GT6", &IVT490State::GT6, 7, 0.1},
+        {"electricity_supplement", &IVT490State::electricity_supplement, 33, 0.1},
+    };
+    const int IVT490State_number_of_float_fields = sizeof(IVT490State_float_fields) / sizeof(FloatField);
+
+    const BoolField IVT490State_bool_fields[] = {
+        {"GP1", &IVT490State::GP1, 11},
+        {"GP2", &IVT490State::GP2, 10},
+        {"GP3", &IVT490State::GP3, 9},
+        {"compressor", &IVT490State::compressor, 13},
+        {"vacation", &IVT490State::vacation, 12},
+        {"P1", &IVT490State::P1, 16},
+        {"P2", &IVT490State::P2, 19},
+        {"alarm", &IVT490State::alarm, 18},
+        {"fan", &IVT490State::fan, 17},
+        {"SV1_open", &IVT490State::SV1_open, 14},
+        {"SV1_close", &IVT490State::SV1_close, 15},
+    };
+    const int IVT490State_number_of_bool_fields = sizeof(IVT490State_bool_fields) / sizeof(BoolField);
+
+    int parse_IVT490(const char *raw, IVT490State &parsed)
+    {
+        float split[IVT490_NO_OF_ITEMS_IN_SENTENCE];
+
+        // Splitting raw string, converting each item in place
+        auto item_begin = raw;
+
+        for (int item = 0; item < IVT490_NO_OF_ITEMS_IN_SENTENCE; item++)
+        {
+            split[item] = atof(item_begin);
+
+            auto separator = strchr(item_begin, ';');
+
+            if (separator == nullptr)
+            {
+                if (item == IVT490_NO_OF_ITEMS_IN_SENTENCE - 1)
+                {
+                    break;
+                }
+                else
+                {
+                    LOG_ERROR("Received raw string did not have correct length (37)!");
+                    return -1;
+                }
+            }
+
+            item_begin = separator + 1;
+        }
+
+        // Interpreting each item
+        for (int i = 0; i < IVT490State_number_of_float_fields; i++)
+        {
+            auto &field = IVT490State_float_fields[i];
+            if (field.item >= 0)
+            {
+                parsed.*field.member = field.scale * split[field.item];
+            }
+        }
+
+        for (int i = 0; i < IVT490State_number_of_bool_fields; i++)
+        {
+            auto &field = IVT490State_bool_fields[i];
+            parsed.*field.member = split[field.item] != 0;
+        }
+
+        return 0;
+    }
+
+}
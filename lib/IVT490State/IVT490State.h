@@ -0,0 +1,74 @@
+#ifndef IVT490_STATE_H
+#define IVT490_STATE_H
+
+// This header is kept free from Arduino dependencies, allowing host tools to share the definitions
+
+#define IVT490_NO_OF_ITEMS_IN_SENTENCE 37
+
+namespace IVT490
+{
+
+    struct IVT490State
+    {
+
+        float GT1;          // Framledningstemperatur, grader Celsius
+        float GT1_target;   // Framledningstemperatur börvärde, grader Celcius
+        float GT1_UL;       // Framledningstemperatur övre gräns, grader Celcius
+        float GT1_LL;       // Framledningstemperatur undre gräns, grader Celcius
+        float GT1_LLT;      // Framledningstemperatur undre gräns för tillskott, grader Celcius
+        float GT2_heatpump; // Utetemperatur input till vp, grader Celcius
+        float GT2_sensor;   // Utetemperatur från sensor, grader Celcius
+        float GT3_1;        // Tappvarmvatten, grader Celcius
+        float GT3_2;        // Varmvatten, grader Celcius
+        float GT3_2_ULT;    // Varmvatten övre gräns för tillskott, grader Celcius
+        float GT3_2_LL;     // Varmvatten under gräns, grader Celcius
+        float GT3_3;        // Värmevatten, grader Celcius
+        float GT3_3_target; // Värmevatten börvärde, grader Celcius
+        float GT3_2_UL;     // Värmevatten övre gräns, grader Celcius
+        float GT3_3_LL;     // Värmevatten undre gräns, grader Celcius
+        float GT3_4;        // Extra acc. tank, grader Celcius
+        float GT5;          // Innetemperatur, grader Celcius
+        float GT6;          // Hetgastemperatur, grader Celcius
+
+        float electricity_supplement; // Eltillskott (elpatron) användning, procent (%) utnyttjande
+
+        bool GP1;        // Lågtrycksvakt
+        bool GP2;        // Högtrycksvakt
+        bool GP3;        // Avfrostningsvakt
+        bool compressor; // Kompressor
+        bool vacation;   // Semesterläge (sänkt framledningstemperatur)
+        bool P1;         // Circulation pump
+        bool P2;         // External pump
+        bool alarm;      // Larm
+        bool fan;        // ??
+        bool SV1_open;   // Shunt öppnar
+        bool SV1_close;  // Shunt stänger
+    };
+
+    // Name and member of each field in the IVT490State that is published, together with the position of the
+    // item in the serial sentence (-1 if not part of the sentence) and the scale it is given in
+    struct FloatField
+    {
+        const char *name;
+        float IVT490State::*member;
+        int item;
+        float scale;
+    };
+
+    struct BoolField
+    {
+        const char *name;
+        bool IVT490State::*member;
+        int item;
+    };
+
+    extern const FloatField IVT490State_float_fields[];
+    extern const int IVT490State_number_of_float_fields;
+    extern const BoolField IVT490State_bool_fields[];
+    extern const int IVT490State_number_of_bool_fields;
+
+    // Parses a raw serial sentence into parsed, returns -1 if the sentence is too short
+    int parse_IVT490(const char *raw, IVT490State &parsed);
+
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,815 @@
+#ifndef INTERFACE_H
+#define INTERFACE_H
+
+#include <ArduinoJson.h>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "IVT490.h"
+#include "Thermistor.h"
+#include "Controller.h"
+#include "EMA.h"
+#include "AdaptiveSampler.h"
+#include "Accumulator.h"
+#include "AnomalyDetector.h"
+#include "SnapshotSource.h"
+#include "Logging.h"
+
+// The settings are taken from config.h, with the defaults of config_defaults.h
+#ifndef CONFIG_DEFAULTS_H
+#error "config.h and config_defaults.h are to be included before Interface.h"
+#endif
+
+namespace Interface
+{
+    // Energy and runtime accounting, 24 hourly and 7 daily buckets
+    typedef Accumulator::Accumulator<24, 7> Accounting;
+
+    // Persisted state, restored on boot
+    struct PersistedState
+    {
+        float GT2_sensor;
+        float resistance_offset;
+        float indoor_temperature_target;
+        float control_value;
+        bool vacation_mode;
+        unsigned long heating_curve_samples;
+        float heating_curve[HeatingCurve::HeatingCurve::NUMBER_OF_POINTS];
+        Accumulator::Aggregate accounting_total;
+    };
+
+    // The hourly and daily accounting, too large for RTC memory, is persisted to flash only. It is restored with
+    // the first serial sentence, moved forward by the wall clock time passed since it was saved.
+    struct PersistedAccounting
+    {
+        uint32_t saved_at; // seconds since the epoch, 0 if the time was not known
+        Accounting::Rings rings;
+    };
+
+    const time_t WALL_CLOCK_VALID = 1577836800; // 2020-01-01, any earlier time is from before NTP synchronization
+
+    // Hashes of the last payloads published on the individual topics of a JSON object, allowing
+    // unchanged values to be skipped in between periodic full refreshes (GENERAL_INDIVIDUAL_TOPICS_ONLY_CHANGED)
+    struct PublishCache
+    {
+        static const unsigned int SIZE = 48;
+        uint32_t hashes[SIZE];
+        unsigned int count = 0;
+        bool refresh = true;
+    };
+
+    inline uint32_t fnv1a(const char *str)
+    {
+        uint32_t hash = 2166136261;
+        while (*str)
+        {
+            hash = (hash ^ (uint8_t)*str++) * 16777619;
+        }
+        return hash;
+    }
+
+    inline bool ends_with(const char *str, const char *suffix)
+    {
+        auto str_length = strlen(str);
+        auto suffix_length = strlen(suffix);
+
+        return str_length >= suffix_length && strcmp(str + str_length - suffix_length, suffix) == 0;
+    }
+
+    // The Interface ties the parsing of the serial output, the sampling of the GT2 sensor, the controller, the
+    // thermistor emulator and the publishing of the state together, as run by the firmware and by the replay
+    // harness in tools/replay. The MQTT client (with the interface of AsyncMqttClient), the ADC, the digipot
+    // and the snapshot stores (with the interfaces of Snapshot::Store and Snapshot::FileStore) are injected,
+    // as are the clock and the EXT_IN relay. Scheduling the work is left to the caller.
+
+    template <typename mqtt_t, typename adc_t, typename pot_t, typename store_t, typename accounting_store_t>
+    class Interface
+    {
+    public:
+        typedef unsigned long (*Clock)();
+        typedef void (*Relay)(bool on);
+        typedef void (*Diagnostics)(JsonDocument &doc);
+
+        Interface(mqtt_t &mqtt, Clock clock, Relay relay)
+            : mqtt(mqtt),
+              GT2_reader(IVT490_ADC_CS, 0),
+              filter(IVT490_ADC_FILTER_TIME_CONSTANT),
+              sampler(IVT490_ADC_INNOVATION_THRESHOLD),
+              GT2_emulator(IVT490_DIGIPOT_CS),
+              controller(clock),
+              snapshot("/snapshot.bin"),
+              accounting_snapshot("/accounting.bin")
+        {
+            this->clock = clock;
+            this->relay = relay;
+        }
+
+        // Configures the controller, anomaly detection and accounting and warm starts from the last persisted
+        // state, if any. The anomaly handler is left to the caller.
+        void begin(const char *base_topic)
+        {
+            // Copied once, such that topics can be built without allocating
+            snprintf(this->base_topic, sizeof(this->base_topic), "%s", base_topic);
+
+            this->controller.set_heating_curve_slope(IVT490_HEATING_CURVE_SLOPE);
+            this->controller.set_indoor_temperature_target(20.0);
+            this->controller.set_indoor_temperature_weight(IVT490_INDOOR_TEMPERATURE_FEEDBACK_CONTROL_WEIGHT);
+            this->controller.set_summer_temperature_limit(IVT490_SUMMER_TEMPERATURE_LIMIT);
+
+            this->anomaly_detector.set_deviation_threshold(IVT490_ANOMALY_DEVIATION_THRESHOLD);
+            this->anomaly_detector.set_GT6_limit(IVT490_GT6_LIMIT);
+
+            this->accumulator.set_supplement_power(IVT490_ELECTRICITY_SUPPLEMENT_POWER);
+
+            // The outdoor temperature is unknown until sampled, replayed or restored
+            this->vp_state.GT2_sensor = NAN;
+
+            this->restore_persisted_state();
+        }
+
+        // Additional members of the diagnostics object, serialized after those of the Interface
+        void on_diagnostics(Diagnostics diagnostics)
+        {
+            this->diagnostics = diagnostics;
+        }
+
+        void subscribe()
+        {
+            this->mqtt.subscribe(this->make_topic("/controller/set/feed_temperature_target"), 0);
+            this->mqtt.subscribe(this->make_topic("/controller/set/indoor_temperature_target"), 0);
+            this->mqtt.subscribe(this->make_topic("/controller/set/outdoor_temperature_offset"), 0);
+            this->mqtt.subscribe(this->make_topic("/controller/feedback/indoor_temperature"), 0);
+            this->mqtt.subscribe(this->make_topic("/controller/set/vacation_mode"), 0);
+#ifdef GENERAL_REPLAY_MODE
+            this->mqtt.subscribe(this->make_topic("/replay/raw"), 0);
+            this->mqtt.subscribe(this->make_topic("/replay/GT2_sensor"), 0);
+#endif
+        }
+
+        void handle_message(const char *topic, const char *payload, size_t length)
+        {
+            // The payload is not null terminated
+            auto message_length = std::min(length, sizeof(this->message_buffer) - 1);
+            memcpy(this->message_buffer, payload, message_length);
+            this->message_buffer[message_length] = '\0';
+
+            if (ends_with(topic, "/controller/set/feed_temperature_target"))
+            {
+                auto value = atof(this->message_buffer);
+
+                if (value == 0)
+                {
+                    LOG_ERROR("Failed to parse payload as a float");
+                    return;
+                }
+
+                this->controller.set_feed_temperature_target(value);
+            }
+            else if (ends_with(topic, "/controller/set/outdoor_temperature_offset"))
+            {
+                auto value = atof(this->message_buffer);
+
+                if (value == 0)
+                {
+                    LOG_ERROR("Failed to parse payload as a float");
+                    return;
+                }
+
+                this->controller.set_outdoor_temperature_offset(value);
+            }
+            else if (ends_with(topic, "/controller/set/indoor_temperature_target"))
+            {
+                auto value = atof(this->message_buffer);
+
+                if (value == 0)
+                {
+                    LOG_ERROR("Failed to parse payload as a float");
+                    return;
+                }
+
+                this->controller.set_indoor_temperature_target(value);
+            }
+            else if (ends_with(topic, "/controller/feedback/indoor_temperature"))
+            {
+                auto value = atof(this->message_buffer);
+
+                if (value == 0)
+                {
+                    LOG_ERROR("Failed to parse payload as a float");
+                    return;
+                }
+
+                this->controller.set_indoor_temperature(value);
+            }
+#ifdef GENERAL_REPLAY_MODE
+            else if (ends_with(topic, "/replay/raw"))
+            {
+                LOG_INFO("Received replayed serial data:", this->message_buffer);
+                this->handle_IVT490_sentence(this->message_buffer);
+            }
+            else if (ends_with(topic, "/replay/GT2_sensor"))
+            {
+                this->handle_GT2_sample(atof(this->message_buffer));
+            }
+#endif
+            else
+            {
+                LOG_ERROR("Received MQTT message on topic which we do not know how to handle. This should not happen!");
+            }
+        }
+
+        void handle_GT2_sample(float value)
+        {
+            auto now = this->clock();
+            this->anomaly_detector.input_GT2_sensor(value, now);
+
+            LOG_DEBUG("    GT2_sensor: ", value);
+
+            // Track real changes faster, but keep a long time constant for the steady state
+            this->sampler.input(this->filter.is_initialized() ? value - this->filter.output() : 0, now);
+            this->filter.set_time_constant(this->sampler.is_tracking() ? IVT490_ADC_FILTER_FAST_TIME_CONSTANT : IVT490_ADC_FILTER_TIME_CONSTANT);
+            this->filter.input(value, now);
+
+            auto filtered_value = this->filter.output();
+            LOG_DEBUG("    GT2_sensor (filtered): ", filtered_value);
+            this->vp_state.GT2_sensor = filtered_value;
+            this->controller.set_outdoor_temperature(filtered_value);
+        }
+
+        void handle_IVT490_sentence(const char *raw)
+        {
+            LOG_INFO("Publishing raw output to MQTT broker...");
+            this->mqtt.publish(
+                this->make_topic("/state/raw"),
+                0,
+                false,
+                raw);
+
+            if (IVT490::parse_IVT490(raw, this->vp_state) < 0)
+            {
+                LOG_ERROR("Failed parsing serial message from IVT490!");
+                return;
+            }
+
+            LOG_INFO("Successfully parsed serial message from IVT490.");
+
+#ifdef GENERAL_REPLAY_MODE
+            if (!this->filter.is_initialized())
+            {
+                LOG_WARN("Replay: No GT2 sensor reading replayed yet, the controller is idle until one is published to /replay/GT2_sensor");
+            }
+#endif
+
+            auto now = this->clock();
+            this->controller.update_heating_curve(this->vp_state);
+            this->restore_accounting();
+            this->accumulator.input(this->vp_state, now);
+            this->anomaly_detector.input(this->vp_state, this->GT2_emulator.get_target_value(), now);
+
+            // The emulated GT2 is considered correct once the heatpump reads what we intend to emulate
+            if (this->startup_first_correct_output == 0 && fabs(this->vp_state.GT2_heatpump - this->GT2_emulator.get_target_value()) <= 0.5)
+            {
+                this->startup_first_correct_output = now;
+                LOG_INFO("First correct output after", this->startup_first_correct_output, "ms");
+            }
+
+            if (!this->serial_connection_initialized)
+            {
+                this->serial_connection_initialized = true;
+                LOG_INFO("Serial connection to IVT490 initialized correctly, enabling state publishing");
+            }
+
+            LOG_INFO("Adjusting thermistor emulator corrections");
+            this->GT2_emulator.adjust_correction(this->vp_state.GT2_heatpump);
+
+            // Cheap enough to keep RTC memory up to date with every sentence
+            this->snapshot.save_to_rtc(this->collect_persisted_state());
+        }
+
+        // Reads the ADC, at a rate adapted to the activity of the signal, returns true as a scheduler task
+        bool sample()
+        {
+            if (this->sampler.is_due(this->clock()))
+            {
+                LOG_DEBUG("Reading ADCs...");
+                this->handle_GT2_sample(this->GT2_reader.read());
+            }
+            return true;
+        }
+
+        // Runs the control code, returns true as a scheduler task
+        bool control()
+        {
+            // Nothing to control from until the outdoor temperature is known, sampled or restored
+            if (!this->filter.is_initialized())
+            {
+                return true;
+            }
+
+            LOG_DEBUG("Running control code...");
+
+            auto [control_value, vacation_mode] = this->controller.get_control_values();
+
+            // Set the control value
+            this->GT2_emulator.set_target_value(control_value);
+            LOG_INFO("Control value:", control_value, "vacation mode:", vacation_mode, "wiper value:", this->GT2_emulator.get_wiper_value());
+
+            // Make sure EXT_IN relay is in correct position
+            this->relay(vacation_mode);
+
+            this->last_control_value = control_value;
+            this->last_vacation_mode = vacation_mode;
+
+            if (this->startup_first_output == 0)
+            {
+                this->startup_first_output = this->clock();
+                LOG_INFO("First output after", this->startup_first_output, "ms");
+            }
+
+#ifdef GENERAL_REPLAY_MODE
+            this->publish_replay_output(control_value, vacation_mode);
+#endif
+            return true;
+        }
+
+        // Publishes one chunk, i.e. a JSON blob or a few of its individual topics, returns true when all is published
+        bool publish_chunk()
+        {
+            // A restored snapshot is as good a starting point as the first serial sentence
+            if (!this->serial_connection_initialized && this->snapshot_source == Snapshot::Source::NONE)
+            {
+                return true;
+            }
+
+            auto &target = this->publish_targets[this->publish_target];
+
+            if (target.needs_serial_state && !this->serial_connection_initialized)
+            {
+                this->publish_target = (this->publish_target + 1) % NUMBER_OF_PUBLISH_TARGETS;
+                return this->publish_target == 0;
+            }
+
+            if (!this->publish_blob_is_published)
+            {
+                LOG_INFO("Publishing", target.suffix, "to MQTT broker...");
+
+                this->json_doc.clear();
+                (this->*target.serialize)(this->json_doc);
+
+                // ArduinoJson drops whatever does not fit without failing
+                if (this->json_doc.overflowed())
+                {
+                    LOG_ERROR("JSON document overflowed serializing", target.suffix, ", increase GENERAL_JSON_DOCUMENT_SIZE");
+                }
+
+                snprintf(this->publish_topic_buffer, sizeof(this->publish_topic_buffer), "%s%s", this->base_topic, target.suffix);
+                this->publish_json_blob(this->publish_topic_buffer, this->json_doc, target.cache);
+
+                this->publish_blob_is_published = true;
+                this->publish_index = 0;
+                return false;
+            }
+
+            if (!this->publish_individual_topics(this->publish_topic_buffer, this->json_doc, target.cache, this->publish_index, GENERAL_PUBLISH_CHUNK_SIZE))
+            {
+                return false;
+            }
+
+            this->publish_blob_is_published = false;
+            this->publish_target = (this->publish_target + 1) % NUMBER_OF_PUBLISH_TARGETS;
+
+            return this->publish_target == 0;
+        }
+
+        void publish_anomaly(const char *channel, const char *kind, bool active, float value, float expected)
+        {
+            if (active)
+            {
+                LOG_WARN("Anomaly:", channel, kind, "value:", value, "expected:", expected);
+            }
+            else
+            {
+                LOG_INFO("Anomaly:", channel, kind, "cleared");
+            }
+
+            StaticJsonDocument<192> doc;
+            doc["channel"] = channel;
+            doc["kind"] = kind;
+            doc["active"] = active;
+            doc["value"] = value;
+            doc["expected"] = expected;
+
+            serializeJson(doc, this->payload_buffer, sizeof(this->payload_buffer));
+
+            this->mqtt.publish(
+                this->make_topic("/events"),
+                0,
+                false,
+                this->payload_buffer);
+        }
+
+        // Persists the state to flash, less frequently than to RTC memory to limit wear
+        void save_to_flash()
+        {
+            this->snapshot.save_to_flash(this->collect_persisted_state());
+            this->save_accounting();
+        }
+
+        void save_before_restart()
+        {
+            auto state = this->collect_persisted_state();
+            this->snapshot.save_to_rtc(state);
+            this->snapshot.save_to_flash(state);
+            this->save_accounting();
+        }
+
+        const IVT490::IVT490State &get_state() const
+        {
+            return this->vp_state;
+        }
+
+        // The state is not known until the first serial sentence, except for GT2_sensor
+        bool serial_connection_is_initialized() const
+        {
+            return this->serial_connection_initialized;
+        }
+
+        Snapshot::Source get_snapshot_source() const
+        {
+            return this->snapshot_source;
+        }
+
+        float get_last_control_value() const
+        {
+            return this->last_control_value;
+        }
+
+        bool get_last_vacation_mode() const
+        {
+            return this->last_vacation_mode;
+        }
+
+        Thermistor::Reader<adc_t, IVT490_ADC_R0> &get_GT2_reader()
+        {
+            return this->GT2_reader;
+        }
+
+        Thermistor::Emulator<pot_t, IVT490_DIGPOT_RESOLUTION, IVT490_DIGIPOT_MAX_RESISTANCE> &get_GT2_emulator()
+        {
+            return this->GT2_emulator;
+        }
+
+        AdaptiveSampler::AdaptiveSampler<IVT490_ADC_SAMPLING_MIN_INTERVAL, IVT490_ADC_SAMPLING_MAX_INTERVAL> &get_sampler()
+        {
+            return this->sampler;
+        }
+
+        Controller::Controller<GENERAL_CONTROL_VALUES_VALIDITY> &get_controller()
+        {
+            return this->controller;
+        }
+
+        AnomalyDetector::AnomalyDetector &get_anomaly_detector()
+        {
+            return this->anomaly_detector;
+        }
+
+        Accounting &get_accumulator()
+        {
+            return this->accumulator;
+        }
+
+        store_t &get_snapshot()
+        {
+            return this->snapshot;
+        }
+
+        accounting_store_t &get_accounting_snapshot()
+        {
+            return this->accounting_snapshot;
+        }
+
+    private:
+        const char *make_topic(const char *suffix)
+        {
+            snprintf(this->topic_buffer, sizeof(this->topic_buffer), "%s%s", this->base_topic, suffix);
+            return this->topic_buffer;
+        }
+
+        void publish_json_blob(const char *topic, JsonDocument &doc, PublishCache &cache)
+        {
+            // Publish the whole state as a single JSON blob
+            if (measureJson(doc) >= sizeof(this->payload_buffer))
+            {
+                LOG_ERROR("JSON blob truncated on", topic, ", increase GENERAL_MQTT_PAYLOAD_BUFFER_SIZE");
+            }
+            serializeJson(doc, this->payload_buffer, sizeof(this->payload_buffer));
+
+            LOG_DEBUG(this->payload_buffer);
+
+            this->mqtt.publish(
+                topic,
+                0,
+                false,
+                this->payload_buffer);
+
+#ifdef GENERAL_INDIVIDUAL_TOPICS_ONLY_CHANGED
+            // Individual topics are only published when changed, unless it is time for a full refresh
+            cache.refresh = cache.count++ % GENERAL_INDIVIDUAL_TOPICS_REFRESH_COUNT == 0;
+#endif
+        }
+
+        // Publishes at most count individual topics, starting from index, returns true when all have been published
+        bool publish_individual_topics(const char *topic, JsonDocument &doc, PublishCache &cache, unsigned int &index, unsigned int count)
+        {
+#ifndef GENERAL_DISABLE_INDIVIDUAL_TOPICS
+            JsonObject root = doc.as<JsonObject>();
+            unsigned int position = 0;
+
+            for (auto pair : root)
+            {
+                if (position++ < index)
+                {
+                    continue;
+                }
+
+                if (count-- == 0)
+                {
+                    return false;
+                }
+
+                snprintf(this->subtopic_buffer, sizeof(this->subtopic_buffer), "%s/%s", topic, pair.key().c_str());
+
+                // Strings are published as is, everything else as JSON
+                if (pair.value().template is<const char *>())
+                {
+                    snprintf(this->payload_buffer, sizeof(this->payload_buffer), "%s", pair.value().template as<const char *>());
+                }
+                else
+                {
+                    serializeJson(pair.value(), this->payload_buffer, sizeof(this->payload_buffer));
+                }
+
+#ifdef GENERAL_INDIVIDUAL_TOPICS_ONLY_CHANGED
+                auto hash = fnv1a(this->subtopic_buffer) ^ fnv1a(this->payload_buffer);
+                bool unchanged = index < PublishCache::SIZE && cache.hashes[index] == hash;
+                if (index < PublishCache::SIZE)
+                {
+                    cache.hashes[index] = hash;
+                }
+                index++;
+
+                if (unchanged && !cache.refresh)
+                {
+                    this->individual_topics_skipped++;
+                    continue;
+                }
+#else
+                index++;
+#endif
+
+                LOG_DEBUG(this->subtopic_buffer, this->payload_buffer);
+
+                this->mqtt.publish(
+                    this->subtopic_buffer,
+                    0,
+                    false,
+                    this->payload_buffer);
+
+                this->individual_topics_published++;
+            }
+#endif
+
+            return true;
+        }
+
+#ifdef GENERAL_REPLAY_MODE
+        void publish_replay_output(float control_value, bool vacation_mode)
+        {
+            StaticJsonDocument<128> doc;
+            doc["control_value"] = control_value;
+            doc["vacation_mode"] = vacation_mode;
+            doc["wiper_value"] = this->GT2_emulator.get_wiper_value();
+
+            serializeJson(doc, this->payload_buffer, sizeof(this->payload_buffer));
+
+            this->mqtt.publish(
+                this->make_topic("/replay/output"),
+                0,
+                false,
+                this->payload_buffer);
+        }
+#endif
+
+        PersistedState collect_persisted_state()
+        {
+            PersistedState state;
+            state.GT2_sensor = this->vp_state.GT2_sensor;
+            state.resistance_offset = this->GT2_emulator.get_resistance_offset();
+            state.indoor_temperature_target = this->controller.get_indoor_temperature_target();
+            state.control_value = this->last_control_value;
+            state.vacation_mode = this->last_vacation_mode;
+
+            auto &curve = this->controller.get_heating_curve();
+            state.heating_curve_samples = curve.get_samples();
+            std::copy(curve.get_feed_temperatures(), curve.get_feed_temperatures() + HeatingCurve::HeatingCurve::NUMBER_OF_POINTS, state.heating_curve);
+
+            state.accounting_total = this->accumulator.get_total();
+
+            return state;
+        }
+
+        void restore_persisted_state()
+        {
+            PersistedState state;
+            this->snapshot_source = this->snapshot.load(state);
+            this->accounting_restore_pending = this->accounting_snapshot.load_from_flash(this->accounting_state);
+
+            if (this->snapshot_source == Snapshot::Source::NONE)
+            {
+                return;
+            }
+
+            // Only a warm restart leaves the filtered value current, after a cold boot the flash copy may be hours
+            // old and the first samples would take minutes to pull it back
+            if (this->snapshot_source == Snapshot::Source::RTC && !isnan(state.GT2_sensor))
+            {
+                this->filter.reset(state.GT2_sensor, this->clock());
+                this->vp_state.GT2_sensor = state.GT2_sensor;
+                this->controller.set_outdoor_temperature(state.GT2_sensor);
+            }
+
+            this->GT2_emulator.set_resistance_offset(state.resistance_offset);
+            this->controller.set_indoor_temperature_target(state.indoor_temperature_target);
+            this->controller.get_heating_curve().set_feed_temperatures(state.heating_curve, state.heating_curve_samples);
+            this->accumulator.set_total(state.accounting_total);
+
+            // Emulate the last known control value until the control code has run
+            if (!isnan(state.control_value))
+            {
+                this->last_control_value = state.control_value;
+                this->last_vacation_mode = state.vacation_mode;
+                this->GT2_emulator.set_target_value(state.control_value);
+                this->relay(state.vacation_mode);
+            }
+
+            LOG_INFO("Restored persisted state from", Snapshot::to_string(this->snapshot_source));
+        }
+
+        void restore_accounting()
+        {
+            if (!this->accounting_restore_pending)
+            {
+                return;
+            }
+            this->accounting_restore_pending = false;
+
+            auto now = time(nullptr);
+            if (this->accounting_state.saved_at == 0 || now < WALL_CLOCK_VALID || now < (time_t)this->accounting_state.saved_at)
+            {
+                LOG_WARN("Accounting: Time not known, hourly and daily aggregates start over");
+                return;
+            }
+
+            // Beyond the daily ring everything has passed, the cap keeps the milliseconds within range
+            auto seconds = std::min<uint32_t>(now - this->accounting_state.saved_at, 8 * 24 * 3600UL);
+            this->accumulator.set_rings(this->accounting_state.rings);
+            this->accumulator.skip(seconds * 1000UL);
+            LOG_INFO("Accounting: Restored hourly and daily aggregates saved", seconds, "s ago");
+        }
+
+        void save_accounting()
+        {
+            // Until restored, the saved rings are worth more than the empty ones
+            if (this->accounting_restore_pending)
+            {
+                return;
+            }
+
+            auto now = time(nullptr);
+            this->accounting_state.saved_at = now >= WALL_CLOCK_VALID ? now : 0;
+            this->accounting_state.rings = this->accumulator.get_rings();
+            this->accounting_snapshot.save_to_flash(this->accounting_state);
+        }
+
+        void serialize_state(JsonDocument &doc)
+        {
+            IVT490::serialize_IVT490State(this->vp_state, doc);
+        }
+
+        void serialize_controller(JsonDocument &doc)
+        {
+            this->controller.serialize(doc);
+        }
+
+        void serialize_accounting(JsonDocument &doc)
+        {
+            this->accumulator.serialize(doc);
+        }
+
+        void serialize_diagnostics(JsonDocument &doc)
+        {
+            auto now = this->clock();
+            doc["uptime"] = now;
+            doc["snapshot_source"] = Snapshot::to_string(this->snapshot_source);
+            doc["startup_first_output"] = this->startup_first_output;
+            doc["startup_first_correct_output"] = this->startup_first_correct_output;
+
+            doc["anomaly_events"] = this->anomaly_detector.get_events();
+
+            // Effective ADC sampling rate since the last publish
+            doc["adc_sampling_interval"] = this->sampler.get_interval();
+            doc["adc_sampling_rate"] = 60000.0 * (this->sampler.get_samples() - this->sampler_samples_at_last_publish) / std::max(1UL, now - this->sampler_last_publish);
+            this->sampler_samples_at_last_publish = this->sampler.get_samples();
+            this->sampler_last_publish = now;
+
+            doc["individual_topics_published"] = this->individual_topics_published;
+            doc["individual_topics_skipped"] = this->individual_topics_skipped;
+
+            if (this->diagnostics)
+            {
+                this->diagnostics(doc);
+            }
+        }
+
+        mqtt_t &mqtt;
+        Clock clock;
+        Relay relay;
+        Diagnostics diagnostics = nullptr;
+
+        // Global states
+        IVT490::IVT490State vp_state;
+        bool serial_connection_initialized = false;
+
+        // Thermistor reader
+        Thermistor::Reader<adc_t, IVT490_ADC_R0> GT2_reader;
+        EMA::Filter<float> filter;
+        AdaptiveSampler::AdaptiveSampler<IVT490_ADC_SAMPLING_MIN_INTERVAL, IVT490_ADC_SAMPLING_MAX_INTERVAL> sampler;
+        unsigned long sampler_samples_at_last_publish = 0;
+        unsigned long sampler_last_publish = 0;
+
+        // Thermistor emulator
+        Thermistor::Emulator<pot_t, IVT490_DIGPOT_RESOLUTION, IVT490_DIGIPOT_MAX_RESISTANCE> GT2_emulator;
+
+        // Controller
+        Controller::Controller<GENERAL_CONTROL_VALUES_VALIDITY> controller;
+        float last_control_value = NAN;
+        bool last_vacation_mode = false;
+
+        AnomalyDetector::AnomalyDetector anomaly_detector;
+        Accounting accumulator;
+
+        // Persisted state
+        store_t snapshot;
+        Snapshot::Source snapshot_source = Snapshot::Source::NONE;
+        accounting_store_t accounting_snapshot;
+        PersistedAccounting accounting_state; // Statically allocated along with the Interface, being over 1 kB
+        bool accounting_restore_pending = false;
+
+        // Startup diagnostics
+        unsigned long startup_first_output = 0;
+        unsigned long startup_first_correct_output = 0;
+
+        // Statically sized buffers, keeping the work of the interface itself free from heap allocations. The MQTT
+        // client and the network stack still allocate for every publish.
+        char base_topic[GENERAL_MQTT_TOPIC_BUFFER_SIZE] = "";
+        char topic_buffer[GENERAL_MQTT_TOPIC_BUFFER_SIZE];
+        char subtopic_buffer[GENERAL_MQTT_TOPIC_BUFFER_SIZE];
+        char payload_buffer[GENERAL_MQTT_PAYLOAD_BUFFER_SIZE];
+        char message_buffer[IVT490_SERIAL_BUFFER_SIZE];
+        char publish_topic_buffer[GENERAL_MQTT_TOPIC_BUFFER_SIZE];
+        StaticJsonDocument<GENERAL_JSON_DOCUMENT_SIZE> json_doc;
+
+        unsigned long individual_topics_published = 0;
+        unsigned long individual_topics_skipped = 0;
+
+        // The JSON objects published every GENERAL_STATE_PUBLISH_INTERVAL
+        struct PublishTarget
+        {
+            const char *suffix;
+            void (Interface::*serialize)(JsonDocument &doc);
+            bool needs_serial_state; // Nothing to publish until the first serial sentence, even after restoring a snapshot
+            PublishCache cache;
+        };
+
+        static const unsigned int NUMBER_OF_PUBLISH_TARGETS = 4;
+
+        PublishTarget publish_targets[NUMBER_OF_PUBLISH_TARGETS] = {
+            {"/state", &Interface::serialize_state, true, {}},
+            {"/controller/state", &Interface::serialize_controller, false, {}},
+            {"/accounting", &Interface::serialize_accounting, false, {}},
+            {"/diagnostics", &Interface::serialize_diagnostics, false, {}},
+        };
+
+        unsigned int publish_target = 0;
+        unsigned int publish_index = 0;
+        bool publish_blob_is_published = false;
+    };
+
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+// The libraries that also run on the host (native tests and tools) log through this header, which uses DebugLog
+// on the target and compiles the log statements away elsewhere, where DebugLog is not available.
+
+#if defined(ARDUINO)
+#include <DebugLog.h>
+#else
+#define LOG_ERROR(...) ((void)0)
+#define LOG_WARN(...) ((void)0)
+#define LOG_INFO(...) ((void)0)
+#define LOG_DEBUG(...) ((void)0)
+#define LOG_TRACE(...) ((void)0)
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,218 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace Metrics
+{
+    // A Formatter writes the metric line(s) with the given index into buffer, returning the number of
+    // characters written (as snprintf) or a negative value when there are no more metrics
+    typedef int (*Formatter)(unsigned int index, char *buffer, size_t size);
+
+    // Formats a single sample named prefix followed by name, preceded by its TYPE line, in the Prometheus
+    // text exposition format. Returns the number of characters written, as snprintf.
+    inline int format(char *buffer, size_t size, const char *prefix, const char *name, const char *type, double value)
+    {
+        if (isnan(value) || isinf(value))
+        {
+            const char *special = isnan(value) ? "NaN" : value > 0 ? "+Inf" : "-Inf";
+            return snprintf(buffer, size, "# TYPE %s%s %s\n%s%s %s\n", prefix, name, type, prefix, name, special);
+        }
+
+        return snprintf(buffer, size, "# TYPE %s%s %s\n%s%s %.10g\n", prefix, name, type, prefix, name, value);
+    }
+
+    // The Server serves metrics in the Prometheus text format to one client at a time. The response is
+    // formatted line by line into a small buffer and written straight to the client, and only as long as
+    // the TCP send buffer has room, such that a scrape never blocks. poll() is to be called repeatedly and
+    // returns true when the server is idle.
+
+    template <typename server_t, typename client_t>
+    class Server
+    {
+    public:
+        static const size_t LINE_SIZE = 160;
+        static const unsigned long TIMEOUT = 5000; // milliseconds
+
+        Server(uint16_t port, Formatter formatter) : server(port)
+        {
+            this->formatter = formatter;
+        }
+
+        void begin()
+        {
+            this->server.begin();
+        }
+
+        bool poll(unsigned long now)
+        {
+            if (this->state == State::IDLE)
+            {
+                this->client = this->server.accept();
+                if (!this->client)
+                {
+                    return true;
+                }
+
+                this->state = State::READING_REQUEST;
+                this->started = now;
+                this->request_length = 0;
+                this->request_line_is_complete = false;
+                this->line_length = 0;
+                this->index = 0;
+                this->bytes = 0;
+            }
+
+            if (!this->client.connected() || now - this->started > TIMEOUT)
+            {
+                this->close(now);
+                return true;
+            }
+
+            if (this->state == State::READING_REQUEST)
+            {
+                this->read_request();
+                return false;
+            }
+
+            if (this->state == State::WRITING_HEADER)
+            {
+                const char *header = this->found
+                                         ? "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n"
+                                         : "HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\n";
+                auto length = strlen(header);
+
+                if ((size_t)this->client.availableForWrite() < length)
+                {
+                    return false;
+                }
+
+                this->bytes += this->client.write(reinterpret_cast<const uint8_t *>(header), length);
+
+                if (!this->found)
+                {
+                    this->close(now);
+                    return true;
+                }
+
+                this->state = State::WRITING_METRICS;
+                return false;
+            }
+
+            // Write as many lines as fit in the send buffer
+            char line[LINE_SIZE];
+            while ((size_t)this->client.availableForWrite() >= LINE_SIZE)
+            {
+                auto length = this->formatter(this->index++, line, sizeof(line));
+
+                if (length < 0)
+                {
+                    this->scrapes++;
+                    this->close(now);
+                    return true;
+                }
+
+                length = std::min((size_t)length, sizeof(line) - 1);
+                this->bytes += this->client.write(reinterpret_cast<const uint8_t *>(line), length);
+            }
+
+            return false;
+        }
+
+        unsigned long get_scrapes()
+        {
+            return this->scrapes;
+        }
+
+        unsigned long get_bytes_served()
+        {
+            return this->bytes_served;
+        }
+
+        unsigned long get_last_bytes()
+        {
+            return this->last_bytes;
+        }
+
+        unsigned long get_last_duration()
+        {
+            return this->last_duration;
+        }
+
+    private:
+        enum class State
+        {
+            IDLE,
+            READING_REQUEST,
+            WRITING_HEADER,
+            WRITING_METRICS
+        };
+
+        void read_request()
+        {
+            while (this->client.available())
+            {
+                auto c = this->client.read();
+
+                if (c == '\n')
+                {
+                    // The request ends with an empty line
+                    if (this->line_length == 0)
+                    {
+                        this->request[this->request_length] = '\0';
+                        this->found = strncmp(this->request, "GET /metrics ", 13) == 0;
+                        this->state = State::WRITING_HEADER;
+                        return;
+                    }
+
+                    this->request_line_is_complete = true;
+                    this->line_length = 0;
+                }
+                else if (c != '\r')
+                {
+                    this->line_length++;
+
+                    // Only the request line is kept
+                    if (!this->request_line_is_complete && this->request_length < sizeof(this->request) - 1)
+                    {
+                        this->request[this->request_length++] = c;
+                    }
+                }
+            }
+        }
+
+        void close(unsigned long now)
+        {
+            this->client.stop();
+            this->state = State::IDLE;
+            this->bytes_served += this->bytes;
+            this->last_bytes = this->bytes;
+            this->last_duration = now - this->started;
+        }
+
+        server_t server;
+        client_t client;
+        Formatter formatter;
+
+        State state = State::IDLE;
+        char request[64];
+        size_t request_length = 0;
+        bool request_line_is_complete = false;
+        size_t line_length = 0;
+        bool found = false;
+        unsigned int index = 0;
+        unsigned long started = 0;
+        unsigned long bytes = 0;
+
+        unsigned long scrapes = 0;
+        unsigned long bytes_served = 0;
+        unsigned long last_bytes = 0;
+        unsigned long last_duration = 0;
+    };
+
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,197 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <algorithm>
+
+namespace Scheduler
+{
+    // Histogram of durations in milliseconds, counting the values up to each of the bounds
+    class Histogram
+    {
+    public:
+        static const int NUMBER_OF_BOUNDS = 11;
+        static constexpr unsigned long BOUNDS[NUMBER_OF_BOUNDS] = {0, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000}; // milliseconds
+
+        void input(unsigned long value)
+        {
+            int bucket = 0;
+            while (bucket < NUMBER_OF_BOUNDS && value > BOUNDS[bucket])
+            {
+                bucket++;
+            }
+
+            this->counts[bucket]++;
+            this->maximum = std::max(this->maximum, value);
+        }
+
+        unsigned long get_count(int bucket) const
+        {
+            return this->counts[bucket];
+        }
+
+        unsigned long get_maximum() const
+        {
+            return this->maximum;
+        }
+
+        template <typename object_t>
+        void serialize(object_t obj, const char *counts_key, const char *maximum_key) const
+        {
+            auto counts = obj.createNestedArray(counts_key);
+            for (auto count : this->counts)
+            {
+                counts.add(count);
+            }
+            obj[maximum_key] = this->maximum;
+        }
+
+    private:
+        unsigned long counts[NUMBER_OF_BOUNDS + 1] = {}; // The last bucket counts everything above the last bound
+        unsigned long maximum = 0;
+    };
+
+    // A task function returns true when it has completed its work for the current period, or false when it
+    // has more work to do, in which case it is resumed on a later tick. Long running work can thereby be split
+    // into chunks, letting tasks with higher priority run in between.
+    typedef bool (*TaskFunction)();
+
+    struct Task
+    {
+        const char *name;
+        unsigned long period;
+        unsigned int priority;
+        TaskFunction function;
+
+        unsigned long due;
+        bool running = false;
+
+        unsigned long runs = 0;
+        unsigned long chunks = 0;
+        unsigned long deadline_misses = 0;
+        unsigned long last_lateness = 0;
+        Histogram lateness; // Time from when the task was due until it was started
+        Histogram jitter;   // Change in lateness from one run to the next
+    };
+
+    // The Scheduler runs periodic tasks cooperatively, starting at most one task (or chunk of a task) per
+    // tick. Among the tasks that are due, the one with the highest priority (lowest value) is run, with
+    // ties broken by the earliest due time. Tasks are first due one period after being added. The clock is
+    // injected to allow for running under a virtual clock.
+
+    template <unsigned int MAX_TASKS>
+    class Scheduler
+    {
+    public:
+        typedef unsigned long (*Clock)();
+
+        Scheduler(Clock clock)
+        {
+            this->clock = clock;
+        }
+
+        bool add(const char *name, unsigned long period, unsigned int priority, TaskFunction function)
+        {
+            if (this->number_of_tasks >= MAX_TASKS)
+            {
+                return false;
+            }
+
+            auto &task = this->tasks[this->number_of_tasks++];
+            task.name = name;
+            task.period = period;
+            task.priority = priority;
+            task.function = function;
+            task.due = this->clock() + period;
+            return true;
+        }
+
+        void tick()
+        {
+            auto now = this->clock();
+
+            Task *next = nullptr;
+            for (unsigned int i = 0; i < this->number_of_tasks; i++)
+            {
+                auto &task = this->tasks[i];
+
+                if ((long)(now - task.due) < 0)
+                {
+                    continue;
+                }
+
+                if (next == nullptr || task.priority < next->priority || (task.priority == next->priority && (long)(task.due - next->due) < 0))
+                {
+                    next = &task;
+                }
+            }
+
+            if (next == nullptr)
+            {
+                return;
+            }
+
+            if (!next->running)
+            {
+                auto lateness = now - next->due;
+                next->running = true;
+                next->lateness.input(lateness);
+                if (next->runs > 0)
+                {
+                    next->jitter.input(lateness > next->last_lateness ? lateness - next->last_lateness : next->last_lateness - lateness);
+                }
+                next->last_lateness = lateness;
+            }
+
+            next->chunks++;
+            if (!next->function())
+            {
+                return;
+            }
+
+            next->running = false;
+            next->runs++;
+
+            // Completing after the next period was due counts as a missed deadline, those periods are skipped
+            next->due += next->period;
+            now = this->clock();
+            if ((long)(now - next->due) >= 0)
+            {
+                next->deadline_misses++;
+                next->due = now + next->period - (now - next->due) % next->period;
+            }
+        }
+
+        unsigned int get_number_of_tasks() const
+        {
+            return this->number_of_tasks;
+        }
+
+        const Task &get_task(unsigned int i) const
+        {
+            return this->tasks[i];
+        }
+
+        template <typename object_t>
+        void serialize(object_t obj) const
+        {
+            for (unsigned int i = 0; i < this->number_of_tasks; i++)
+            {
+                auto &task = this->tasks[i];
+                auto task_obj = obj.createNestedObject(task.name);
+
+                task_obj["runs"] = task.runs;
+                task_obj["chunks"] = task.chunks;
+                task_obj["deadline_misses"] = task.deadline_misses;
+                task.lateness.serialize(task_obj, "lateness", "lateness_max");
+                task.jitter.serialize(task_obj, "jitter", "jitter_max");
+            }
+        }
+
+    private:
+        Clock clock;
+        Task tasks[MAX_TASKS];
+        unsigned int number_of_tasks = 0;
+    };
+
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,206 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <DebugLog.h>
+#include <type_traits>
+
+#include "SnapshotSource.h"
+
+namespace Snapshot
+{
+    inline uint32_t crc32(const uint8_t *data, size_t length)
+    {
+        uint32_t crc = 0xFFFFFFFF;
+
+        for (size_t i = 0; i < length; i++)
+        {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+            }
+        }
+
+        return ~crc;
+    }
+
+    // The FileStore keeps a versioned and checksummed copy of a plain payload struct in a file on LittleFS,
+    // which survives resets and power loss. A payload stored by another VERSION is rejected as invalid. The
+    // payload is written and read in place, without a copy on the stack, allowing for larger payloads.
+
+    template <typename payload_t, uint32_t VERSION>
+    class FileStore
+    {
+    public:
+        FileStore(const char *path)
+        {
+            this->path = path;
+        }
+
+        void save_to_flash(const payload_t &payload)
+        {
+            Header header = {MAGIC, VERSION, crc32(reinterpret_cast<const uint8_t *>(&payload), sizeof(payload_t))};
+
+            if (!LittleFS.begin())
+            {
+                LOG_ERROR("Snapshot: Failed mounting filesystem!");
+                return;
+            }
+
+            auto file = LittleFS.open(this->path, "w");
+            if (!file || file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(Header)) != sizeof(Header) ||
+                file.write(reinterpret_cast<const uint8_t *>(&payload), sizeof(payload_t)) != sizeof(payload_t))
+            {
+                LOG_ERROR("Snapshot: Failed writing", this->path);
+            }
+            file.close();
+        }
+
+        // The payload is only valid if true is returned
+        bool load_from_flash(payload_t &payload)
+        {
+            Header header{};
+
+            if (!LittleFS.begin())
+            {
+                LOG_ERROR("Snapshot: Failed mounting filesystem!");
+                return false;
+            }
+
+            auto file = LittleFS.open(this->path, "r");
+            if (!file)
+            {
+                LOG_INFO("Snapshot: No snapshot found at", this->path);
+                return false;
+            }
+
+            auto length = file.read(reinterpret_cast<uint8_t *>(&header), sizeof(Header));
+            length += file.read(reinterpret_cast<uint8_t *>(&payload), sizeof(payload_t));
+            file.close();
+
+            return length == sizeof(Header) + sizeof(payload_t) && this->check(header, payload);
+        }
+
+    protected:
+        static const uint32_t MAGIC = 0x49565434; // "IVT4"
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t crc;
+        };
+
+        struct alignas(4) Record
+        {
+            Header header;
+            payload_t payload;
+        };
+
+        // The payload is stored and restored as raw bytes
+        static_assert(std::is_trivially_copyable<payload_t>::value, "Snapshot payload must be trivially copyable");
+
+        void seal(Record &record, const payload_t &payload)
+        {
+            record.header.magic = MAGIC;
+            record.header.version = VERSION;
+            memcpy(&record.payload, &payload, sizeof(payload_t));
+            record.header.crc = crc32(reinterpret_cast<const uint8_t *>(&record.payload), sizeof(payload_t));
+        }
+
+        bool check(const Header &header, const payload_t &payload)
+        {
+            if (header.magic != MAGIC || header.version != VERSION)
+            {
+                LOG_DEBUG("Snapshot: Magic or version mismatch");
+                return false;
+            }
+
+            if (header.crc != crc32(reinterpret_cast<const uint8_t *>(&payload), sizeof(payload_t)))
+            {
+                LOG_WARN("Snapshot: CRC mismatch");
+                return false;
+            }
+
+            return true;
+        }
+
+        bool unseal(const Record &record, payload_t &payload)
+        {
+            if (!this->check(record.header, record.payload))
+            {
+                return false;
+            }
+
+            memcpy(&payload, &record.payload, sizeof(payload_t));
+            return true;
+        }
+
+        const char *path;
+    };
+
+    // The Store additionally keeps a copy in RTC user memory, which survives resets but not power loss, and
+    // is preferred when restoring as it is written more often.
+
+    template <typename payload_t, uint32_t VERSION>
+    class Store : public FileStore<payload_t, VERSION>
+    {
+    public:
+        Store(const char *path) : FileStore<payload_t, VERSION>(path) {}
+
+        void save_to_rtc(const payload_t &payload)
+        {
+            Record record{};
+            this->seal(record, payload);
+
+            if (!ESP.rtcUserMemoryWrite(RTC_OFFSET, reinterpret_cast<uint32_t *>(&record), sizeof(Record)))
+            {
+                LOG_ERROR("Snapshot: Failed writing to RTC memory!");
+            }
+        }
+
+        bool load_from_rtc(payload_t &payload)
+        {
+            Record record{};
+
+            if (!ESP.rtcUserMemoryRead(RTC_OFFSET, reinterpret_cast<uint32_t *>(&record), sizeof(Record)))
+            {
+                LOG_ERROR("Snapshot: Failed reading from RTC memory!");
+                return false;
+            }
+
+            return this->unseal(record, payload);
+        }
+
+        Source load(payload_t &payload)
+        {
+            if (this->load_from_rtc(payload))
+            {
+                LOG_INFO("Snapshot: Restored from RTC memory");
+                return Source::RTC;
+            }
+
+            if (this->load_from_flash(payload))
+            {
+                LOG_INFO("Snapshot: Restored from flash");
+                return Source::FLASH;
+            }
+
+            LOG_WARN("Snapshot: No valid snapshot available");
+            return Source::NONE;
+        }
+
+    private:
+        typedef typename FileStore<payload_t, VERSION>::Record Record;
+
+        // The first 128 bytes (blocks 0 to 31) of RTC user memory hold the OTA command of eboot
+        static const uint32_t RTC_OFFSET = 32; // 4 byte blocks
+
+        // RTC user memory is 512 bytes, of which 384 are left after the blocks reserved for eboot
+        static_assert(sizeof(Record) <= 512 - RTC_OFFSET * 4, "Snapshot payload does not fit in RTC user memory");
+    };
+
+}
+#endif
\ No newline at end of file
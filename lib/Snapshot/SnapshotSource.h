@@ -0,0 +1,29 @@
+#ifndef SNAPSHOT_SOURCE_H
+#define SNAPSHOT_SOURCE_H
+
+// Where a snapshot was restored from, kept apart from Snapshot.h to be usable without LittleFS
+
+namespace Snapshot
+{
+    enum class Source
+    {
+        NONE,
+        RTC,
+        FLASH
+    };
+
+    inline const char *to_string(Source source)
+    {
+        switch (source)
+        {
+        case Source::RTC:
+            return "rtc";
+        case Source::FLASH:
+            return "flash";
+        default:
+            return "none";
+        }
+    }
+
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "Thermistor.h"
+
+namespace Thermistor
+{
+    static const int NTC_number_of_values = 27;
+    // Ohm
+    static const float NTC_resistances[NTC_number_of_values] = {-154300,
+                                                                -111700,
+                                                                -81700,
+                                                                -60500,
+                                                                -45100,
+                                                                -33950,
+                                                                -25800,
+                                                                -19770,
+                                                                -15280,
+                                                                -11900,
+                                                                -9330,
+                                                                -7370,
+                                                                -5870,
+                                                                -4700,
+                                                                -3490,
+                                                                -3070,
+                                                                -2510,
+                                                                -2055,
+                                                                -1696,
+                                                                -1405,
+                                                                -1170,
+                                                                -980,
+                                                                -824,
+                                                                -696,
+                                                                -590,
+                                                                -503,
+                                                                -430};
+    // Degrees Celcuis
+    static const float NTC_temperatures[NTC_number_of_values] = {-40,
+                                                                 -35,
+                                                                 -30,
+                                                                 -25,
+                                                                 -20,
+                                                                 -15,
+                                                                 -10,
+                                                                 -5,
+                                                                 0,
+                                                                 5,
+                                                                 10,
+                                                                 15,
+                                                                 20,
+                                                                 25,
+                                                                 30,
+                                                                 35,
+                                                                 40,
+                                                                 45,
+                                                                 50,
+                                                                 55,
+                                                                 60,
+                                                                 65,
+                                                                 70,
+                                                                 75,
+                                                                 80,
+                                                                 85,
+                                                                 90
+
+    };
+
+    // Piecewise linear interpolation in a table with increasing inputs, clamped to the ends of the table
+    static float interpolate(float value, const float *inputs, const float *outputs, int size)
+    {
+        if (value <= inputs[0])
+        {
+            return outputs[0];
+        }
+        if (value >= inputs[size - 1])
+        {
+            return outputs[size - 1];
+        }
+
+        int i = 1;
+        while (value > inputs[i])
+        {
+            i++;
+        }
+
+        if (value == inputs[i])
+        {
+            return outputs[i];
+        }
+
+        return (value - inputs[i - 1]) * (outputs[i] - outputs[i - 1]) / (inputs[i] - inputs[i - 1]) + outputs[i - 1];
+    }
+
+    // The resistances are negated in the table, making them increase with the temperature
+    float NTC_interpolate_temperature(float resistance)
+    {
+        return interpolate(-resistance, NTC_resistances, NTC_temperatures, NTC_number_of_values);
+    }
+
+    float NTC_interpolate_resistance(float temperature)
+    {
+        return -interpolate(temperature, NTC_temperatures, NTC_resistances, NTC_number_of_values);
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#ifndef THERMISTOR_H
+#define THERMISTOR_H
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <stdint.h>
+
+#include "Logging.h"
+
+namespace Thermistor
+{
+
+    float NTC_interpolate_temperature(float resistance);
+    float NTC_interpolate_resistance(float temperature);
+
+    // The Reader expects the following circuit
+    //   Vs
+    //   |
+    //  NTC
+    //   |
+    //   o ----- Vadc
+    //   |
+    //  R_0
+    //   |
+    //  GND
+    //
+    // The ADC is injected, with the interface of MCP3208 from MCP_ADC, to allow for running on the host.
+
+    template <typename adc_t, unsigned int R_0>
+    class Reader
+    {
+    public:
+        Reader(uint8_t CS_pin, uint8_t channel)
+        {
+            this->adc.begin(CS_pin);
+            this->channel = channel;
+        }
+
+        float read()
+        {
+            float adc_value = this->adc.analogRead(this->channel);
+            float max_value = this->adc.maxValue();
+
+            LOG_DEBUG("ADC value (channel", this->channel, "):", adc_value);
+            LOG_DEBUG("ADC max value:", max_value);
+
+            float resistance = adc_value > 0.0f ? R_0 * ((max_value / adc_value) - 1) : std::numeric_limits<float>::max();
+
+            LOG_DEBUG("Resistance:", resistance, "ohm");
+
+            return NTC_interpolate_temperature(resistance);
+        }
+
+        adc_t &get_adc()
+        {
+            return this->adc;
+        }
+
+    private:
+        adc_t adc;
+        uint8_t channel;
+    };
+
+    // The Emulator expects the following circuit
+    //
+    //            MCP41XXX
+    //
+    //          -------
+    //      CS -|     |- VDD
+    //     SCK -|     |- PB0 ---- Heatpump
+    //      SI -|     |- PW0 ---- connection
+    //     VSS -|     |- PA0
+    //          -------
+    //
+    // The digipot is injected, with the interface of MCP41_Simple, to allow for running on the host.
+
+    template <typename pot_t, uint8_t RESOLUTION, unsigned int MAX_RESISTANCE, unsigned int WIPER_RESISTANCE = 125>
+    class Emulator
+    {
+    public:
+        Emulator(uint8_t CS_pin)
+        {
+            this->pot.begin(CS_pin);
+            this->set_wiper_value_from_temperature(6);
+        }
+
+        void set_target_value(float target)
+        {
+            this->target = target;
+            this->set_wiper_value_from_temperature(this->target);
+        }
+
+        void set_wiper_value_from_temperature(float temperature)
+        {
+            static unsigned int STEPS = pow(2, RESOLUTION);
+            LOG_DEBUG("Calculating wiper value for temperature:", temperature);
+
+            // Write an initial guess based on reverse interpolation of the NTC values
+            auto wanted_resistance = NTC_interpolate_resistance(temperature);
+
+            LOG_DEBUG("    equalling wanted resistance:", wanted_resistance);
+
+            wanted_resistance += this->resistance_offset;
+            LOG_DEBUG("    adding resistance offset:", this->resistance_offset);
+            LOG_DEBUG("    resulting in wanted resistance:", wanted_resistance);
+
+            // This expects the connections to be made over PB0-PW0
+            float fraction = (wanted_resistance - WIPER_RESISTANCE) / MAX_RESISTANCE;
+            fraction = std::max(0.0f, std::min(1.0f, fraction)); // Capping to usable range of digipot
+            LOG_DEBUG("    equalling capped fraction:", fraction);
+
+            uint8_t wiper_value = (uint8_t)((STEPS - 1) * fraction);
+            LOG_DEBUG("    equalling wiper value:", wiper_value);
+
+            LOG_INFO("Writing new wiper value to pot:", wiper_value);
+
+            this->pot.setWiper(wiper_value);
+            this->wiper_value = wiper_value;
+        }
+
+        uint8_t get_wiper_value()
+        {
+            return this->wiper_value;
+        }
+
+        float get_target_value()
+        {
+            return this->target;
+        }
+
+        float get_resistance_offset()
+        {
+            return this->resistance_offset;
+        }
+
+        void set_resistance_offset(float offset)
+        {
+            this->resistance_offset = offset;
+        }
+
+        void adjust_correction(float feedback)
+        {
+            LOG_INFO("Adjusting thermistor emulator correction based on feedback.");
+            LOG_DEBUG("    Target value:", this->target);
+            LOG_DEBUG("    Feedback value:", feedback);
+
+            // This expects the connection to be made over PB0-PW0
+            auto resistance_at_target = NTC_interpolate_resistance(this->target);
+            auto resistance_at_feedback = NTC_interpolate_resistance(feedback);
+            LOG_DEBUG("    resistance at target:", resistance_at_target);
+            LOG_DEBUG("    resistance at feedback:", resistance_at_feedback);
+
+            this->resistance_offset += resistance_at_target - resistance_at_feedback;
+            LOG_DEBUG("Current resistance offset:", this->resistance_offset);
+        }
+
+        pot_t &get_pot()
+        {
+            return this->pot;
+        }
+
+    private:
+        float target = 6;
+        pot_t pot;
+        uint8_t wiper_value = 0;
+        float resistance_offset = 0;
+    };
+
+}
+#endif
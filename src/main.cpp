@@ -1,4 +1,5 @@
 #include "config.h"
+#include "config_defaults.h"
 
 #include <ArduinoOTA.h>
 #include <ESP8266WiFi.h>
@@ -8,12 +9,21 @@
 #include <SoftwareSerial.h>
 #include <ArduinoJson.h>
 #include <DebugLog.h>
-
-#include "IVT490.h"
-#include "SMA.h"
+#include <MCP41_Simple.h>
+#include <MCP_ADC.h>
+
+#include "Snapshot.h"
+#include "Scheduler.h"
+#include "Interface.h"
+#ifdef GENERAL_METRICS_PORT
+#include "Metrics.h"
+#endif
 
 reactesp::ReactESP app;
 
+// Periodic tasks, control and sampling take priority over publishing
+Scheduler::Scheduler<5> scheduler(millis);
+
 AsyncMqttClient mqttClient;
 Ticker mqttReconnectTimer;
 
@@ -21,22 +31,98 @@ WiFiEventHandler wifiConnectHandler;
 WiFiEventHandler wifiDisconnectHandler;
 Ticker wifiReconnectTimer;
 
-// IVT490 serial connection
+// IVT490 serial connection, replaced by the /replay/raw topic in replay mode
+#ifndef GENERAL_REPLAY_MODE
 SoftwareSerial ivtSerial(IVT490_SERIAL_RX);
-bool IVT490_serial_connection_is_initialized = false;
+#endif
+
+// The serial sentence being received
+char serial_buffer[IVT490_SERIAL_BUFFER_SIZE];
+size_t serial_length = 0;
+
+void write_EXT_IN_relay(bool on)
+{
+  digitalWrite(IVT490_EXT_IN_RELAY_PIN, on);
+}
+
+// The interface itself, persisting its state to RTC memory and flash
+typedef Snapshot::Store<Interface::PersistedState, 2> SnapshotStore;
+typedef Snapshot::FileStore<Interface::PersistedAccounting, 1> AccountingStore;
+Interface::Interface<AsyncMqttClient, MCP3208, MCP41_Simple, SnapshotStore, AccountingStore> ivt490(mqttClient, millis, write_EXT_IN_relay);
+
+// Heap diagnostics
+uint32_t heap_min_free = UINT32_MAX;
+uint32_t heap_min_max_free_block = UINT32_MAX;
+
+#ifdef GENERAL_MEMORY_BUDGET_MODE
+// Counting allocations made after setup() has finished, requires linking with --wrap for each of the
+// functions below (see platformio.ini). The SDK and lwIP allocate through the pvPort* functions of the
+// core rather than through malloc, so both are wrapped. Allocations made from within the heap
+// implementation itself, or from code in ROM, are not counted.
+bool setup_is_complete = false;
+unsigned long allocations_after_setup = 0;
+unsigned long allocations_at_last_publish = 0;
+
+extern "C"
+{
+  void *__real_malloc(size_t size);
+  void *__real_calloc(size_t count, size_t size);
+  void *__real_realloc(void *ptr, size_t size);
+
+  void *__wrap_malloc(size_t size)
+  {
+    allocations_after_setup += setup_is_complete;
+    return __real_malloc(size);
+  }
+
+  void *__wrap_calloc(size_t count, size_t size)
+  {
+    allocations_after_setup += setup_is_complete;
+    return __real_calloc(count, size);
+  }
+
+  void *__wrap_realloc(void *ptr, size_t size)
+  {
+    allocations_after_setup += setup_is_complete;
+    return __real_realloc(ptr, size);
+  }
+
+  void *__real_pvPortMalloc(size_t size, const char *file, int line);
+  void *__real_pvPortCalloc(size_t count, size_t size, const char *file, int line);
+  void *__real_pvPortZalloc(size_t size, const char *file, int line);
+  void *__real_pvPortRealloc(void *ptr, size_t size, const char *file, int line);
 
-// Global states
-IVT490::IVT490State vp_state;
+  void *__wrap_pvPortMalloc(size_t size, const char *file, int line)
+  {
+    allocations_after_setup += setup_is_complete;
+    return __real_pvPortMalloc(size, file, line);
+  }
+
+  void *__wrap_pvPortCalloc(size_t count, size_t size, const char *file, int line)
+  {
+    allocations_after_setup += setup_is_complete;
+    return __real_pvPortCalloc(count, size, file, line);
+  }
 
-// Thermistor reader
-IVT490::IVT490ThermistorReader<IVT490_ADC_R0> GT2_reader(IVT490_ADC_CS, 0);
-SMA::Filter<float, IVT490_ADC_FILTER_WINDOW_COUNT> filter;
+  void *__wrap_pvPortZalloc(size_t size, const char *file, int line)
+  {
+    allocations_after_setup += setup_is_complete;
+    return __real_pvPortZalloc(size, file, line);
+  }
 
-// Thermistor emulator
-IVT490::IVT490ThermistorEmulator<IVT490_DIGPOT_RESOLUTION, IVT490_DIGIPOT_MAX_RESISTANCE> GT2_emulator(IVT490_DIGIPOT_CS);
+  void *__wrap_pvPortRealloc(void *ptr, size_t size, const char *file, int line)
+  {
+    allocations_after_setup += setup_is_complete;
+    return __real_pvPortRealloc(ptr, size, file, line);
+  }
+}
+#endif
 
-// Controller
-IVT490::Controller<GENERAL_CONTROL_VALUES_VALIDITY> controller;
+#ifdef GENERAL_METRICS_PORT
+// Metrics scrape endpoint
+int format_metric(unsigned int index, char *buffer, size_t size);
+Metrics::Server<WiFiServer, WiFiClient> metrics_server(GENERAL_METRICS_PORT, format_metric);
+#endif
 
 void connectToWifi()
 {
@@ -66,11 +152,7 @@ void onWifiDisconnect(const WiFiEventStationModeDisconnected &event)
 void onMqttConnect(bool sessionPresent)
 {
   LOG_INFO("Connected to MQTT.");
-  mqttClient.subscribe((MQTT_BASE_TOPIC + "/controller/set/feed_temperature_target").c_str(), 0);
-  mqttClient.subscribe((MQTT_BASE_TOPIC + "/controller/set/indoor_temperature_target").c_str(), 0);
-  mqttClient.subscribe((MQTT_BASE_TOPIC + "/controller/set/outdoor_temperature_offset").c_str(), 0);
-  mqttClient.subscribe((MQTT_BASE_TOPIC + "/controller/feedback/indoor_temperature").c_str(), 0);
-  mqttClient.subscribe((MQTT_BASE_TOPIC + "/controller/set/vacation_mode").c_str(), 0);
+  ivt490.subscribe();
 }
 
 void onMqttDisconnect(AsyncMqttClientDisconnectReason reason)
@@ -100,58 +182,7 @@ void onMqttMessage(char *topic, char *payload, AsyncMqttClientMessageProperties
   LOG_DEBUG("  index: ", index);
   LOG_DEBUG("  total: ", total);
 
-  if (String(topic).endsWith("/controller/set/feed_temperature_target"))
-  {
-    auto value = String(payload).toFloat();
-
-    if (value == 0)
-    {
-      LOG_ERROR("Failed to parse payload as a float");
-      return;
-    }
-
-    controller.set_feed_temperature_target(value);
-  }
-  else if (String(topic).endsWith("/controller/set/outdoor_temperature_offset"))
-  {
-    auto value = String(payload).toFloat();
-
-    if (value == 0)
-    {
-      LOG_ERROR("Failed to parse payload as a float");
-      return;
-    }
-
-    controller.set_outdoor_temperature_offset(value);
-  }
-  else if (String(topic).endsWith("/controller/set/indoor_temperature_target"))
-  {
-    auto value = String(payload).toFloat();
-
-    if (value == 0)
-    {
-      LOG_ERROR("Failed to parse payload as a float");
-      return;
-    }
-
-    controller.set_indoor_temperature_target(value);
-  }
-  else if (String(topic).endsWith("/controller/feedback/indoor_temperature"))
-  {
-    auto value = String(payload).toFloat();
-
-    if (value == 0)
-    {
-      LOG_ERROR("Failed to parse payload as a float");
-      return;
-    }
-
-    controller.set_indoor_temperature(value);
-  }
-  else
-  {
-    LOG_ERROR("Received MQTT message on topic which we do not know how to handle. This should not happen!");
-  }
+  ivt490.handle_message(topic, payload, len);
 }
 
 void onMqttPublish(uint16_t packetId)
@@ -160,33 +191,127 @@ void onMqttPublish(uint16_t packetId)
   LOG_ERROR("  packetId: ", packetId);
 }
 
-void publish_json_object(String &topic, DynamicJsonDocument &doc)
+// The diagnostics of the device, following those of the interface
+void serialize_diagnostics(JsonDocument &doc)
 {
-  // Publish the whole state as a single JSON blob
-  String json;
-  serializeJson(doc, json);
+  auto free_heap = ESP.getFreeHeap();
+  auto max_free_block = ESP.getMaxFreeBlockSize();
+  heap_min_free = min(heap_min_free, free_heap);
+  heap_min_max_free_block = min(heap_min_max_free_block, max_free_block);
+
+  doc["heap_free"] = free_heap;
+  doc["heap_min_free"] = heap_min_free;
+  doc["heap_max_free_block"] = max_free_block;
+  doc["heap_min_max_free_block"] = heap_min_max_free_block;
+  doc["heap_fragmentation"] = ESP.getHeapFragmentation();
+
+  scheduler.serialize(doc.createNestedObject("scheduler"));
+
+#ifdef GENERAL_METRICS_PORT
+  doc["metrics_scrapes"] = metrics_server.get_scrapes();
+  doc["metrics_bytes_served"] = metrics_server.get_bytes_served();
+  doc["metrics_last_scrape_bytes"] = metrics_server.get_last_bytes();
+  doc["metrics_last_scrape_duration"] = metrics_server.get_last_duration();
+#endif
 
-  LOG_DEBUG(json);
+#ifdef GENERAL_MEMORY_BUDGET_MODE
+  doc["allocations_after_setup"] = allocations_after_setup;
+  doc["allocations_since_last_publish"] = allocations_after_setup - allocations_at_last_publish;
+  allocations_at_last_publish = allocations_after_setup;
+#endif
+}
 
-  mqttClient.publish(
-      (topic).c_str(),
-      0,
-      false,
-      json.c_str());
+#ifdef GENERAL_METRICS_PORT
+// Metrics served besides the fields of the IVT490State
+struct Metric
+{
+  const char *name;
+  const char *type;
+  float (*value)();
+};
+
+const Metric metrics[] = {
+    {"control_value", "gauge", []() -> float
+     { return ivt490.get_last_control_value(); }},
+    {"vacation_mode", "gauge", []() -> float
+     { return ivt490.get_last_vacation_mode(); }},
+    {"feed_temperature_target", "gauge", []() -> float
+     { return ivt490.get_controller().get_feed_temperature_target(); }},
+    {"feed_temperature_target_valid", "gauge", []() -> float
+     { return ivt490.get_controller().feed_temperature_target_is_valid(); }},
+    {"indoor_temperature", "gauge", []() -> float
+     { return ivt490.get_controller().get_indoor_temperature(); }},
+    {"indoor_temperature_valid", "gauge", []() -> float
+     { return ivt490.get_controller().indoor_temperature_is_valid(); }},
+    {"outdoor_temperature_offset", "gauge", []() -> float
+     { return ivt490.get_controller().get_outdoor_temperature_offset(); }},
+    {"outdoor_temperature_offset_valid", "gauge", []() -> float
+     { return ivt490.get_controller().outdoor_temperature_offset_is_valid(); }},
+    {"indoor_temperature_target", "gauge", []() -> float
+     { return ivt490.get_controller().get_indoor_temperature_target(); }},
+    {"heating_curve_samples", "gauge", []() -> float
+     { return ivt490.get_controller().get_heating_curve().get_samples(); }},
+    {"compressor_runtime_hours_total", "counter", []() -> float
+     { return ivt490.get_accumulator().get_total().compressor_runtime; }},
+    {"compressor_starts_total", "counter", []() -> float
+     { return ivt490.get_accumulator().get_total().compressor_starts; }},
+    {"P1_runtime_hours_total", "counter", []() -> float
+     { return ivt490.get_accumulator().get_total().P1_runtime; }},
+    {"fan_runtime_hours_total", "counter", []() -> float
+     { return ivt490.get_accumulator().get_total().fan_runtime; }},
+    {"defrost_runtime_hours_total", "counter", []() -> float
+     { return ivt490.get_accumulator().get_total().defrost_runtime; }},
+    {"supplement_energy_kwh_total", "counter", []() -> float
+     { return ivt490.get_accumulator().get_total().supplement_energy; }},
+    {"heating_degree_hours_total", "counter", []() -> float
+     { return ivt490.get_accumulator().get_total().heating_degree_hours; }},
+    {"anomaly_events_total", "counter", []() -> float
+     { return ivt490.get_anomaly_detector().get_events(); }},
+    {"adc_sampling_interval_seconds", "gauge", []() -> float
+     { return ivt490.get_sampler().get_interval() / 1000.0; }},
+    {"uptime_seconds", "gauge", []() -> float
+     { return millis() / 1000.0; }},
+    {"heap_free_bytes", "gauge", []() -> float
+     { return ESP.getFreeHeap(); }},
+    {"heap_max_free_block_bytes", "gauge", []() -> float
+     { return ESP.getMaxFreeBlockSize(); }},
+    {"metrics_scrapes_total", "counter", []() -> float
+     { return metrics_server.get_scrapes(); }},
+    {"metrics_bytes_served_total", "counter", []() -> float
+     { return metrics_server.get_bytes_served(); }},
+    {"metrics_last_scrape_bytes", "gauge", []() -> float
+     { return metrics_server.get_last_bytes(); }},
+    {"metrics_last_scrape_duration_seconds", "gauge", []() -> float
+     { return metrics_server.get_last_duration() / 1000.0; }},
+};
+
+int format_metric(unsigned int index, char *buffer, size_t size)
+{
+  if (index < (unsigned int)IVT490::IVT490State_number_of_float_fields)
+  {
+    // Not known until the first serial sentence, except for GT2_sensor which is NaN until sampled
+    auto &field = IVT490::IVT490State_float_fields[index];
+    auto is_known = ivt490.serial_connection_is_initialized() || field.item < 0;
+    return Metrics::format(buffer, size, "ivt490_", field.name, "gauge", is_known ? ivt490.get_state().*field.member : NAN);
+  }
+  index -= IVT490::IVT490State_number_of_float_fields;
 
-  // Publish on individual topics
-  JsonObject root = doc.as<JsonObject>();
-  for (auto pair : root)
+  if (index < (unsigned int)IVT490::IVT490State_number_of_bool_fields)
   {
-    LOG_DEBUG(pair.key().c_str(), pair.value().as<String>());
+    auto &field = IVT490::IVT490State_bool_fields[index];
+    return Metrics::format(buffer, size, "ivt490_", field.name, "gauge", ivt490.serial_connection_is_initialized() ? ivt490.get_state().*field.member : NAN);
+  }
+  index -= IVT490::IVT490State_number_of_bool_fields;
 
-    mqttClient.publish(
-        (topic + String("/") + pair.key().c_str()).c_str(),
-        0,
-        false,
-        pair.value().as<String>().c_str());
+  if (index < sizeof(metrics) / sizeof(Metric))
+  {
+    auto &metric = metrics[index];
+    return Metrics::format(buffer, size, "ivt490_", metric.name, metric.type, metric.value());
   }
+
+  return -1;
 }
+#endif
 
 void setup()
 {
@@ -196,10 +321,12 @@ void setup()
   pinMode(IVT490_EXT_IN_RELAY_PIN, OUTPUT);
   digitalWrite(IVT490_EXT_IN_RELAY_PIN, LOW);
 
+#ifndef GENERAL_REPLAY_MODE
   // IVT490 serial connection
   // Baud rate = 9600
   // IVT490 should output every 60th second
   ivtSerial.begin(9600);
+#endif
 
   // Attach wifi handlers
   wifiConnectHandler = WiFi.onStationModeGotIP(onWifiConnect);
@@ -220,80 +347,67 @@ void setup()
   // Connect to wifi and subsequently to mqtt broker
   connectToWifi();
 
-  // Configure controller
-  controller.set_heating_curve_slope(IVT490_HEATING_CURVE_SLOPE);
-  controller.set_indoor_temperature_target(20.0);
-  controller.set_indoor_temperature_weight(IVT490_INDOOR_TEMPERATURE_FEEDBACK_CONTROL_WEIGHT);
-  controller.set_summer_temperature_limit(IVT490_SUMMER_TEMPERATURE_LIMIT);
-
-  // Read ADCs continuously
-  app.onRepeat(IVT490_ADC_SAMPLING_INTERVAL, []()
-               {
-                 LOG_DEBUG("Reading ADCs...");
-                 auto value = GT2_reader.read();
-                 LOG_DEBUG("    GT2_sensor: ", value);
-                 auto filtered_value = filter(value);
-                 LOG_DEBUG("    GT2_sensor (filtered): ", filtered_value);
-                 vp_state.GT2_sensor = filtered_value;
-                 controller.set_outdoor_temperature(filtered_value); });
+  // Wall clock, synchronized once connected
+  configTime(0, 0, GENERAL_NTP_SERVER);
 
-  // Run control code
-  app.onRepeat(IVT490_CONTROL_INTERVAL, []()
-               {
-                 LOG_DEBUG("Running control code...");
+  // Configure the interface and warm start from the last persisted state, if any. MQTT_BASE_TOPIC may be
+  // given as a String or a literal.
+  ivt490.on_diagnostics(serialize_diagnostics);
+  ivt490.get_anomaly_detector().on_anomaly([](const char *channel, const char *kind, bool active, float value, float expected)
+                                           { ivt490.publish_anomaly(channel, kind, active, value, expected); });
+  ivt490.begin(String(MQTT_BASE_TOPIC).c_str());
+
+#ifndef GENERAL_REPLAY_MODE
+  // Read ADCs, at a rate adapted to the activity of the signal
+  scheduler.add("adc", IVT490_ADC_SAMPLING_MIN_INTERVAL, 1, []()
+                { return ivt490.sample(); });
+#endif
 
-                auto [control_value, vacation_mode] = controller.get_control_values();
+  // Run control code
+  scheduler.add("control", IVT490_CONTROL_INTERVAL, 0, []()
+                { return ivt490.control(); });
+
+  // Publish state, split in chunks to not hold up control and sampling
+  scheduler.add("publish", GENERAL_STATE_PUBLISH_INTERVAL, 2, []()
+                { return ivt490.publish_chunk(); });
+
+#ifdef GENERAL_METRICS_PORT
+  // Serve metrics, a chunk at a time
+  metrics_server.begin();
+  scheduler.add("metrics", GENERAL_METRICS_POLL_INTERVAL, 3, []()
+                { return metrics_server.poll(millis()); });
+#endif
 
-                 // Set the control value
-                 GT2_emulator.set_target_value(control_value);
+  // Persist state to flash, less frequently to limit wear
+  scheduler.add("snapshot", GENERAL_SNAPSHOT_INTERVAL, 4, []()
+                {
+                  ivt490.save_to_flash();
+                  return true; });
 
-                 // Make sure EXT_IN relay is in correct position
-                 digitalWrite(IVT490_EXT_IN_RELAY_PIN, vacation_mode); });
+  app.onTick([]()
+             { scheduler.tick(); });
 
-  // Serial listener to IVT490
+#ifndef GENERAL_REPLAY_MODE
+  // Serial listener to IVT490, assembling sentences without blocking while the rest arrives
   app.onAvailable(ivtSerial, []()
                   {
-                    auto raw = ivtSerial.readStringUntil('\n');
-                    LOG_INFO("Received serial data from IVT490:", raw);
-
-                    LOG_INFO("Publishing raw output to MQTT broker...");
-                    mqttClient.publish(
-                        (MQTT_BASE_TOPIC + String("/state/raw")).c_str(),
-                        0,
-                        false,
-                        raw.c_str());
-
-                    if (parse_IVT490(raw, vp_state) < 0)
+                    while (ivtSerial.available())
                     {
-                      LOG_ERROR("Failed parsing serial message from IVT490!");
-                      return;
-                    }
-
-                    LOG_INFO("Successfully parsed serial message from IVT490.");
-
-                    if (!IVT490_serial_connection_is_initialized){
-                      IVT490_serial_connection_is_initialized = true;
-                      LOG_INFO("Serial connection to IVT490 initialized correctly, enabling state publishing");
-                      app.onRepeat(GENERAL_STATE_PUBLISH_INTERVAL, []
-                                  {
-                                      LOG_INFO("Publishing to MQTT broker...");
-
-                                      // IVT490 state
-                                      auto doc = IVT490::serialize_IVT490State(vp_state);
-                                      auto topic = MQTT_BASE_TOPIC + String("/state");
-                                      publish_json_object(topic, doc);
-
-                                      doc.clear();
-
-                                      // Controller state
-                                      doc = controller.serialize();
-                                      topic = MQTT_BASE_TOPIC + String("/controller/state");
-                                      publish_json_object(topic, doc);
-                                      });
-                    }
-
-                    LOG_INFO("Adjusting thermistor emulator corrections");
-                    GT2_emulator.adjust_correction(vp_state.GT2_heatpump); });
+                      auto c = ivtSerial.read();
+
+                      if (c != '\n')
+                      {
+                        serial_buffer[serial_length] = c;
+                        serial_length = min(serial_length + 1, sizeof(serial_buffer) - 1);
+                        continue;
+                      }
+
+                      serial_buffer[serial_length] = '\0';
+                      serial_length = 0;
+                      LOG_INFO("Received serial data from IVT490:", serial_buffer);
+                      ivt490.handle_IVT490_sentence(serial_buffer);
+                    } });
+#endif
 
   // Configure OTA
   ArduinoOTA.setHostname(OTA_HOSTNAME);
@@ -304,10 +418,19 @@ void setup()
   app.onTick([]()
              { ArduinoOTA.handle(); });
 
+#ifndef GENERAL_MEMORY_BUDGET_MODE
   // Reset once a day to avoid mysterious fails...
-  app.onDelay(24 * 3600 * 1000, ESP.restart);
+  app.onDelay(24 * 3600 * 1000, []()
+              {
+                ivt490.save_before_restart();
+                ESP.restart(); });
+#endif
 
   LOG_INFO("Setup complete, waiting for serial connection to IVT490 to initialize...");
+
+#ifdef GENERAL_MEMORY_BUDGET_MODE
+  setup_is_complete = true;
+#endif
 }
 
 void loop()
@@ -0,0 +1,163 @@
+#include <unity.h>
+
+#include "Accumulator.h"
+
+const unsigned long MINUTE = 60000;
+const unsigned long HOUR = 3600000;
+
+IVT490::IVT490State state;
+
+void setUp(void)
+{
+    state = {};
+    state.GT2_sensor = 17.0;
+    state.GT6 = 60.0;
+}
+
+void tearDown(void) {}
+
+void test_runtime_is_integrated_from_the_previous_sentence(void)
+{
+    Accumulator::Accumulator<24, 7> accumulator;
+
+    accumulator.input(state, 0);
+    state.compressor = true;
+    state.P1 = true;
+    accumulator.input(state, 10 * MINUTE); // Compressor off until now
+    for (unsigned long t = 11 * MINUTE; t <= 40 * MINUTE; t += MINUTE)
+    {
+        accumulator.input(state, t); // Compressor on for 30 minutes
+    }
+
+    auto &total = accumulator.get_total();
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 0.5, total.compressor_runtime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 0.5, total.P1_runtime);
+    TEST_ASSERT_EQUAL(1, total.compressor_starts);
+}
+
+void test_interval_spanning_an_hour_is_split(void)
+{
+    Accumulator::Accumulator<24, 7> accumulator;
+    state.compressor = true;
+
+    for (unsigned long t = 0; t <= HOUR - 2 * MINUTE; t += 2 * MINUTE)
+    {
+        accumulator.input(state, t);
+    }
+    accumulator.input(state, HOUR + 4 * MINUTE);
+
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 4.0 / 60, accumulator.get_hour(0).compressor_runtime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 1.0, accumulator.get_hour(1).compressor_runtime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 64.0 / 60, accumulator.get_total().compressor_runtime);
+}
+
+void test_supplement_energy_and_degree_hours(void)
+{
+    Accumulator::Accumulator<24, 7> accumulator;
+    accumulator.set_supplement_power(9.0);
+    state.electricity_supplement = 50;
+    state.GT2_sensor = -3.0;
+
+    for (unsigned long t = 0; t <= HOUR; t += MINUTE)
+    {
+        accumulator.input(state, t);
+    }
+
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 4.5, accumulator.get_total().supplement_energy);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 20.0, accumulator.get_total().heating_degree_hours);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 4.5, accumulator.get_day(0).supplement_energy);
+}
+
+void test_gap_is_not_integrated_but_start_is_counted(void)
+{
+    Accumulator::Accumulator<24, 7> accumulator;
+
+    accumulator.input(state, 0);
+    state.compressor = true;
+    accumulator.input(state, 3 * HOUR + 30 * MINUTE);
+
+    auto &total = accumulator.get_total();
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.0, total.compressor_runtime);
+    TEST_ASSERT_EQUAL(1, total.compressor_starts);
+
+    // The buckets follow time over the gap
+    TEST_ASSERT_EQUAL(1, accumulator.get_hour(0).compressor_starts);
+    TEST_ASSERT_EQUAL(0, accumulator.get_hour(3).compressor_starts);
+}
+
+void test_GT6_extremes(void)
+{
+    Accumulator::Accumulator<24, 7> accumulator;
+    const float GT6[] = {60.0, 85.5, 42.0, 70.0};
+
+    unsigned long t = 0;
+    for (auto value : GT6)
+    {
+        state.GT6 = value;
+        accumulator.input(state, t += MINUTE);
+    }
+
+    TEST_ASSERT_EQUAL_FLOAT(42.0, accumulator.get_total().GT6_min);
+    TEST_ASSERT_EQUAL_FLOAT(85.5, accumulator.get_total().GT6_max);
+}
+
+void test_days_roll_over_after_24_hours(void)
+{
+    Accumulator::Accumulator<24, 7> accumulator;
+    state.fan = true;
+
+    for (unsigned long t = 0; t <= 25 * HOUR; t += 5 * MINUTE)
+    {
+        accumulator.input(state, t);
+    }
+
+    TEST_ASSERT_FLOAT_WITHIN(1e-2, 1.0, accumulator.get_day(0).fan_runtime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-2, 24.0, accumulator.get_day(1).fan_runtime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-2, 25.0, accumulator.get_total().fan_runtime);
+}
+
+void test_restored_rings_carry_on_after_the_time_skipped(void)
+{
+    Accumulator::Accumulator<24, 7> before;
+    state.fan = true;
+
+    for (unsigned long t = 0; t <= 2 * HOUR; t += 5 * MINUTE)
+    {
+        before.input(state, t);
+    }
+
+    // Off for an hour and a half, the restored rings start over from a new time base
+    Accumulator::Accumulator<24, 7> after;
+    after.set_rings(before.get_rings());
+    after.skip(HOUR + 30 * MINUTE);
+
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.0, after.get_hour(1).fan_runtime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 1.0, after.get_hour(2).fan_runtime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 1.0, after.get_hour(3).fan_runtime);
+
+    for (unsigned long t = 5 * HOUR; t <= 5 * HOUR + 40 * MINUTE; t += 5 * MINUTE)
+    {
+        after.input(state, t); // Across the end of the hour
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 10.0 / 60, after.get_hour(0).fan_runtime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 30.0 / 60, after.get_hour(1).fan_runtime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 2.0 + 40.0 / 60, after.get_day(0).fan_runtime);
+
+    // Beyond the length of the rings, everything has passed
+    after.skip(30 * 24 * HOUR);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.0, after.get_day(0).fan_runtime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.0, after.get_day(6).fan_runtime);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_runtime_is_integrated_from_the_previous_sentence);
+    RUN_TEST(test_interval_spanning_an_hour_is_split);
+    RUN_TEST(test_supplement_energy_and_degree_hours);
+    RUN_TEST(test_gap_is_not_integrated_but_start_is_counted);
+    RUN_TEST(test_GT6_extremes);
+    RUN_TEST(test_days_roll_over_after_24_hours);
+    RUN_TEST(test_restored_rings_carry_on_after_the_time_skipped);
+    return UNITY_END();
+}
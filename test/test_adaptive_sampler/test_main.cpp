@@ -0,0 +1,82 @@
+#include <unity.h>
+
+#include "AdaptiveSampler.h"
+#include "EMA.h"
+
+const unsigned long SECOND = 1000;
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_interval_backs_off_while_stable(void)
+{
+    AdaptiveSampler::AdaptiveSampler<1000, 30000> sampler(0.5);
+
+    TEST_ASSERT_TRUE(sampler.is_due(0));
+    sampler.input(0.1, 0);
+    TEST_ASSERT_EQUAL(2000, sampler.get_interval());
+    TEST_ASSERT_FALSE(sampler.is_due(1999));
+    TEST_ASSERT_TRUE(sampler.is_due(2000));
+
+    for (int i = 0; i < 10; i++)
+    {
+        sampler.input(0.1, 0);
+    }
+    TEST_ASSERT_EQUAL(30000, sampler.get_interval());
+}
+
+void test_innovation_bursts_and_tracks(void)
+{
+    AdaptiveSampler::AdaptiveSampler<1000, 30000> sampler(0.5);
+
+    for (int i = 0; i < 10; i++)
+    {
+        sampler.input(0.0, 0);
+    }
+
+    sampler.input(-0.8, 0);
+    TEST_ASSERT_EQUAL(1000, sampler.get_interval());
+    TEST_ASSERT_FALSE(sampler.is_tracking());
+
+    sampler.input(-0.8, 0);
+    sampler.input(-0.8, 0);
+    TEST_ASSERT_TRUE(sampler.is_tracking());
+
+    sampler.input(0.1, 0);
+    TEST_ASSERT_FALSE(sampler.is_tracking());
+    TEST_ASSERT_EQUAL(2000, sampler.get_interval());
+    TEST_ASSERT_EQUAL(14, sampler.get_samples());
+}
+
+void test_filter_response_is_independent_of_sample_spacing(void)
+{
+    EMA::Filter<float> fast(300 * SECOND);
+    EMA::Filter<float> slow(300 * SECOND);
+
+    fast.input(0, 0);
+    slow.input(0, 0);
+
+    // A step of 10 degrees, sampled every second and every 30 seconds respectively
+    for (unsigned long t = SECOND; t <= 300 * SECOND; t += SECOND)
+    {
+        fast.input(10, t);
+        if (t % (30 * SECOND) == 0)
+        {
+            slow.input(10, t);
+        }
+    }
+
+    // After one time constant, about 63% of the step
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 6.32, fast.output());
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 6.32, slow.output());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_interval_backs_off_while_stable);
+    RUN_TEST(test_innovation_bursts_and_tracks);
+    RUN_TEST(test_filter_response_is_independent_of_sample_spacing);
+    return UNITY_END();
+}
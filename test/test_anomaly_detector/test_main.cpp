@@ -0,0 +1,250 @@
+#include <unity.h>
+#include <string.h>
+
+#include "AnomalyDetector.h"
+
+const unsigned long SECOND = 1000;
+const unsigned long MINUTE = 60000;
+const unsigned long HOUR = 3600000;
+
+// Events reported by the detector under test
+struct Event
+{
+    const char *channel;
+    const char *kind;
+    bool active;
+};
+
+Event events[64];
+int number_of_events = 0;
+
+void record(const char *channel, const char *kind, bool active, float value, float expected)
+{
+    if (number_of_events < 64)
+    {
+        events[number_of_events++] = {channel, kind, active};
+    }
+}
+
+int count_raised(const char *channel, const char *kind)
+{
+    int count = 0;
+    for (int i = 0; i < number_of_events; i++)
+    {
+        count += events[i].active && strcmp(events[i].channel, channel) == 0 && strcmp(events[i].kind, kind) == 0;
+    }
+    return count;
+}
+
+AnomalyDetector::AnomalyDetector detector;
+IVT490::IVT490State state;
+
+// Small deterministic noise at the resolution of the serial output
+float noise(unsigned long t)
+{
+    return 0.1 * ((t / MINUTE * 7) % 3) - 0.1;
+}
+
+// A healthy heatpump cycling the compressor 40 minutes on, 40 minutes off
+void healthy_state(unsigned long t)
+{
+    auto in_cycle = t % (80 * MINUTE);
+    state.compressor = in_cycle < 40 * MINUTE;
+
+    if (state.compressor)
+    {
+        auto x = 1 - expf(-(float)in_cycle / (3 * MINUTE));
+        state.GT6 = 40 + 45 * x;
+        state.GT1 = 30 + 10 * x;
+        state.GT3_3 = 28 + 8 * x;
+    }
+    else
+    {
+        auto x = expf(-(float)(in_cycle - 40 * MINUTE) / (10 * MINUTE));
+        state.GT6 = 40 + 45 * x;
+        state.GT1 = 30 + 10 * x;
+        state.GT3_3 = 28 + 8 * x;
+    }
+
+    state.GT6 += noise(t);
+    state.GT1 += noise(t);
+    state.GT3_3 += noise(t);
+    state.GT5 = 21 + noise(t);
+    state.GT2_heatpump = 5.0;
+
+    // The shunt adjusts in both directions every few minutes
+    state.SV1_open = (t / MINUTE) % 6 == 0;
+    state.SV1_close = (t / MINUTE) % 6 == 3;
+}
+
+void setUp(void)
+{
+    detector = AnomalyDetector::AnomalyDetector();
+    detector.on_anomaly(record);
+    number_of_events = 0;
+    state = {};
+}
+
+void tearDown(void) {}
+
+void test_compressor_cycles_raise_no_events(void)
+{
+    for (unsigned long t = 0; t < 24 * HOUR; t += MINUTE)
+    {
+        healthy_state(t);
+        detector.input(state, 5.0, t);
+    }
+
+    TEST_ASSERT_EQUAL(0, number_of_events);
+}
+
+void test_compressor_start_after_long_stop_raises_no_events(void)
+{
+    // Temperatures settle completely while the compressor is stopped, collapsing the variance
+    unsigned long t = 0;
+    for (; t < 6 * HOUR; t += MINUTE)
+    {
+        healthy_state(79 * MINUTE);
+        detector.input(state, 5.0, t);
+    }
+
+    for (unsigned long in_cycle = 0; in_cycle < 40 * MINUTE; in_cycle += MINUTE, t += MINUTE)
+    {
+        healthy_state(in_cycle);
+        detector.input(state, 5.0, t);
+    }
+
+    TEST_ASSERT_EQUAL(0, number_of_events);
+}
+
+void test_hot_gas_deviation_while_running(void)
+{
+    unsigned long t = 0;
+    for (; t < 24 * HOUR; t += MINUTE)
+    {
+        healthy_state(t);
+        detector.input(state, 5.0, t);
+    }
+
+    // Hot gas temperature jumps while the compressor has been running for a while, within the limit
+    for (; t % (80 * MINUTE) != 30 * MINUTE; t += MINUTE)
+    {
+        healthy_state(t);
+        detector.input(state, 5.0, t);
+    }
+    healthy_state(t);
+    state.GT6 += 15;
+    detector.input(state, 5.0, t);
+
+    TEST_ASSERT_EQUAL(1, count_raised("GT6", "deviation"));
+    TEST_ASSERT_EQUAL(0, count_raised("GT6", "limit"));
+    TEST_ASSERT_EQUAL(1, number_of_events);
+}
+
+void test_hot_gas_limit(void)
+{
+    healthy_state(0);
+    state.GT6 = 125;
+    detector.input(state, 5.0, 0);
+
+    TEST_ASSERT_EQUAL(1, count_raised("GT6", "limit"));
+}
+
+void test_GT2_sensor_open_circuit(void)
+{
+    unsigned long t = 0;
+    for (; t < HOUR; t += 5 * SECOND)
+    {
+        detector.input_GT2_sensor(5.0 + noise(t), t);
+    }
+
+    detector.input_GT2_sensor(-40, t += 5 * SECOND);
+    TEST_ASSERT_EQUAL(1, count_raised("GT2_sensor", "fault"));
+
+    detector.input_GT2_sensor(5.0, t += 5 * SECOND);
+    TEST_ASSERT_FALSE(events[number_of_events - 1].active);
+}
+
+void test_GT2_sensor_spike(void)
+{
+    unsigned long t = 0;
+    for (; t < HOUR; t += 5 * SECOND)
+    {
+        detector.input_GT2_sensor(5.0 + noise(t), t);
+    }
+    TEST_ASSERT_EQUAL(0, number_of_events);
+
+    detector.input_GT2_sensor(12.0, t);
+    TEST_ASSERT_EQUAL(1, count_raised("GT2_sensor", "deviation"));
+}
+
+void test_statistics_window_is_independent_of_sample_rate(void)
+{
+    AnomalyDetector::EWStatistics fast(10 * MINUTE);
+    AnomalyDetector::EWStatistics slow(10 * MINUTE);
+
+    // A step from 0 to 10 degrees, sampled every second and every 30 seconds respectively
+    for (unsigned long t = 0; t <= 10 * MINUTE; t += SECOND)
+    {
+        fast.input(t == 0 ? 0 : 10, t);
+        if (t % (30 * SECOND) == 0)
+        {
+            slow.input(t == 0 ? 0 : 10, t);
+        }
+    }
+
+    // After one time constant, about 63% of the step
+    TEST_ASSERT_FLOAT_WITHIN(0.2, 6.3, fast.get_mean());
+    TEST_ASSERT_FLOAT_WITHIN(0.2, fast.get_mean(), slow.get_mean());
+}
+
+void test_stuck_shunt(void)
+{
+    state.SV1_close = true;
+    for (unsigned long t = 0; t < 29 * MINUTE; t += MINUTE)
+    {
+        detector.input(state, 0, t);
+    }
+    TEST_ASSERT_EQUAL(0, count_raised("SV1_close", "stuck"));
+
+    detector.input(state, 0, 29 * MINUTE);
+    TEST_ASSERT_EQUAL(1, count_raised("SV1_close", "stuck"));
+}
+
+void test_pressure_switch_trip(void)
+{
+    detector.input(state, 0, 0);
+    state.GP2 = true;
+    detector.input(state, 0, MINUTE);
+
+    TEST_ASSERT_EQUAL(1, count_raised("GP2", "tripped"));
+}
+
+void test_emulator_mismatch(void)
+{
+    state.GT2_heatpump = 8.0;
+    for (unsigned long t = 0; t < 4 * MINUTE; t += MINUTE)
+    {
+        detector.input(state, 5.0, t);
+    }
+    TEST_ASSERT_EQUAL(0, count_raised("GT2_heatpump", "mismatch"));
+
+    detector.input(state, 5.0, 4 * MINUTE);
+    TEST_ASSERT_EQUAL(1, count_raised("GT2_heatpump", "mismatch"));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_compressor_cycles_raise_no_events);
+    RUN_TEST(test_compressor_start_after_long_stop_raises_no_events);
+    RUN_TEST(test_hot_gas_deviation_while_running);
+    RUN_TEST(test_hot_gas_limit);
+    RUN_TEST(test_GT2_sensor_open_circuit);
+    RUN_TEST(test_GT2_sensor_spike);
+    RUN_TEST(test_statistics_window_is_independent_of_sample_rate);
+    RUN_TEST(test_stuck_shunt);
+    RUN_TEST(test_pressure_switch_trip);
+    RUN_TEST(test_emulator_mismatch);
+    return UNITY_END();
+}
@@ -0,0 +1,91 @@
+#include <unity.h>
+
+#include "Controller.h"
+
+const unsigned long VALIDITY = 360000;
+
+unsigned long now = 0;
+
+unsigned long virtual_clock()
+{
+    return now;
+}
+
+Controller::Controller<VALIDITY> controller(virtual_clock);
+
+void setUp(void)
+{
+    now = 1000;
+    controller = Controller::Controller<VALIDITY>(virtual_clock);
+    controller.set_heating_curve_slope(3);
+    controller.set_indoor_temperature_weight(10);
+    controller.set_summer_temperature_limit(14);
+    controller.set_outdoor_temperature(-5);
+}
+
+void tearDown(void) {}
+
+void test_outdoor_temperature_is_passed_through(void)
+{
+    auto [control_value, vacation_mode] = controller.get_control_values();
+    TEST_ASSERT_EQUAL_FLOAT(-5, control_value);
+    TEST_ASSERT_FALSE(vacation_mode);
+}
+
+void test_offset_expires(void)
+{
+    controller.set_outdoor_temperature_offset(3);
+    TEST_ASSERT_EQUAL_FLOAT(-2, controller.get_control_values().first);
+
+    now += VALIDITY;
+    TEST_ASSERT_TRUE(controller.outdoor_temperature_offset_is_valid());
+
+    now += 1;
+    TEST_ASSERT_FALSE(controller.outdoor_temperature_offset_is_valid());
+    TEST_ASSERT_EQUAL_FLOAT(-5, controller.get_control_values().first);
+}
+
+void test_indoor_temperature_feedback(void)
+{
+    controller.set_indoor_temperature_target(20);
+    controller.set_indoor_temperature(20.5);
+
+    // Too warm indoors, emulate a warmer outdoor temperature
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0, controller.get_control_values().first);
+}
+
+void test_feed_temperature_target_follows_heating_curve(void)
+{
+    controller.set_feed_temperature_target(HeatingCurve::heating_curve(3, -10));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, -10, controller.get_control_values().first);
+
+    // The target takes precedence over the offset, until it expires
+    controller.set_outdoor_temperature_offset(3);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, -10, controller.get_control_values().first);
+
+    now += VALIDITY + 1;
+    controller.set_outdoor_temperature_offset(3);
+    TEST_ASSERT_EQUAL_FLOAT(-2, controller.get_control_values().first);
+}
+
+void test_vacation_mode_near_freezing(void)
+{
+    // A feed temperature this low would stop P1 while it is freezing outdoors
+    controller.set_outdoor_temperature(0);
+    controller.set_outdoor_temperature_offset(15);
+
+    auto [control_value, vacation_mode] = controller.get_control_values();
+    TEST_ASSERT_EQUAL_FLOAT(13, control_value);
+    TEST_ASSERT_TRUE(vacation_mode);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_outdoor_temperature_is_passed_through);
+    RUN_TEST(test_offset_expires);
+    RUN_TEST(test_indoor_temperature_feedback);
+    RUN_TEST(test_feed_temperature_target_follows_heating_curve);
+    RUN_TEST(test_vacation_mode_near_freezing);
+    return UNITY_END();
+}
@@ -0,0 +1,111 @@
+#include <unity.h>
+
+#include "HeatingCurve.h"
+
+const float SLOPE = 5;
+const float LOWER_LIMIT = 20;
+const float UPPER_LIMIT = 55;
+
+HeatingCurve::HeatingCurve curve;
+
+void assert_non_increasing(void)
+{
+    auto feed_temperatures = curve.get_feed_temperatures();
+    for (int i = 1; i < HeatingCurve::HeatingCurve::NUMBER_OF_POINTS; i++)
+    {
+        TEST_ASSERT_TRUE(feed_temperatures[i] <= feed_temperatures[i - 1]);
+    }
+}
+
+void setUp(void)
+{
+    curve = HeatingCurve::HeatingCurve();
+    curve.reset(SLOPE);
+}
+
+void tearDown(void) {}
+
+void test_seeded_curve_is_inverted(void)
+{
+    for (float outdoor_temperature = -20; outdoor_temperature <= 10; outdoor_temperature += 2.5)
+    {
+        auto feed_temperature = HeatingCurve::heating_curve(SLOPE, outdoor_temperature);
+        TEST_ASSERT_FLOAT_WITHIN(0.01, outdoor_temperature, curve.outdoor_temperature(feed_temperature));
+    }
+}
+
+void test_learns_parallel_offset(void)
+{
+    for (int n = 0; n < 50; n++)
+    {
+        for (float outdoor_temperature = -10; outdoor_temperature <= 10; outdoor_temperature += 1)
+        {
+            TEST_ASSERT_TRUE(curve.learn(outdoor_temperature, HeatingCurve::heating_curve(SLOPE, outdoor_temperature) + 3, LOWER_LIMIT, UPPER_LIMIT));
+        }
+    }
+
+    assert_non_increasing();
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 0, curve.outdoor_temperature(HeatingCurve::heating_curve(SLOPE, 0) + 3));
+}
+
+void test_clamped_feed_temperatures_are_not_learned(void)
+{
+    TEST_ASSERT_FALSE(curve.learn(0, LOWER_LIMIT, LOWER_LIMIT, UPPER_LIMIT));
+    TEST_ASSERT_FALSE(curve.learn(-30, UPPER_LIMIT, LOWER_LIMIT, UPPER_LIMIT));
+    TEST_ASSERT_FALSE(curve.learn(25, 30, LOWER_LIMIT, UPPER_LIMIT));
+    TEST_ASSERT_EQUAL(0, curve.get_samples());
+}
+
+void test_update_is_kept_at_both_points(void)
+{
+    // A sample close to the upper point of a segment mostly updates that point
+    auto feed_temperatures = curve.get_feed_temperatures();
+    auto before_lower = feed_temperatures[20];
+    auto before_upper = feed_temperatures[21];
+
+    TEST_ASSERT_TRUE(curve.learn(1.9, HeatingCurve::heating_curve(SLOPE, 1.9) + 1, LOWER_LIMIT, UPPER_LIMIT));
+
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.5 * 0.05, feed_temperatures[20] - before_lower);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.5 * 0.95, feed_temperatures[21] - before_upper);
+    assert_non_increasing();
+}
+
+void test_crossing_update_meets_halfway(void)
+{
+    // The upper point is raised past the lower one, neither is clamped to the other
+    auto feed_temperatures = curve.get_feed_temperatures();
+    auto before_lower = feed_temperatures[20];
+    auto before_upper = feed_temperatures[21];
+
+    TEST_ASSERT_TRUE(curve.learn(1.9, HeatingCurve::heating_curve(SLOPE, 1.9) + 4, LOWER_LIMIT, UPPER_LIMIT));
+
+    TEST_ASSERT_EQUAL_FLOAT(feed_temperatures[20], feed_temperatures[21]);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.5 * 4, feed_temperatures[20] - before_lower + feed_temperatures[21] - before_upper);
+    assert_non_increasing();
+}
+
+void test_upper_limit_applies_to_inverse(void)
+{
+    // The upper limit is only known once a sentence has been learned from
+    auto unlimited = curve.outdoor_temperature(UPPER_LIMIT + 10);
+    curve.learn(0, HeatingCurve::heating_curve(SLOPE, 0), LOWER_LIMIT, UPPER_LIMIT);
+
+    auto limit = curve.outdoor_temperature(UPPER_LIMIT);
+    TEST_ASSERT_TRUE(unlimited < limit);
+    TEST_ASSERT_EQUAL_FLOAT(limit, curve.outdoor_temperature(UPPER_LIMIT + 10));
+
+    // Below the lower limit, the curve is followed to tell that the target is too low
+    TEST_ASSERT_TRUE(curve.outdoor_temperature(LOWER_LIMIT - 5) > curve.outdoor_temperature(LOWER_LIMIT));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_seeded_curve_is_inverted);
+    RUN_TEST(test_learns_parallel_offset);
+    RUN_TEST(test_clamped_feed_temperatures_are_not_learned);
+    RUN_TEST(test_update_is_kept_at_both_points);
+    RUN_TEST(test_crossing_update_meets_halfway);
+    RUN_TEST(test_upper_limit_applies_to_inverse);
+    return UNITY_END();
+}
@@ -0,0 +1,273 @@
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#define GENERAL_CONTROL_VALUES_VALIDITY 360000
+#define GENERAL_PUBLISH_CHUNK_SIZE 4
+#define IVT490_HEATING_CURVE_SLOPE 3.0
+#define IVT490_ADC_CS 15
+#define IVT490_ADC_R0 10000
+#define IVT490_ADC_SAMPLING_MIN_INTERVAL 1000
+#define IVT490_ADC_FILTER_TIME_CONSTANT 300000
+#define IVT490_DIGIPOT_CS 2
+#define IVT490_DIGPOT_RESOLUTION 8
+#define IVT490_DIGIPOT_MAX_RESISTANCE 100000
+#define IVT490_INDOOR_TEMPERATURE_FEEDBACK_CONTROL_WEIGHT 10
+#define IVT490_SUMMER_TEMPERATURE_LIMIT 14.0
+
+#include "config_defaults.h"
+#include "Interface.h"
+
+unsigned long now = 0;
+
+unsigned long virtual_clock()
+{
+    return now;
+}
+
+std::vector<int> relay_writes;
+
+void write_relay(bool on)
+{
+    relay_writes.push_back(on);
+}
+
+// Records what is subscribed to and published, with the interface of AsyncMqttClient
+struct RecordingClient
+{
+    std::vector<std::string> subscriptions;
+    std::vector<std::pair<std::string, std::string>> published;
+
+    uint16_t subscribe(const char *topic, uint8_t qos)
+    {
+        this->subscriptions.push_back(topic);
+        return 0;
+    }
+
+    uint16_t publish(const char *topic, uint8_t qos, bool retain, const char *payload)
+    {
+        this->published.push_back({topic, payload});
+        return 0;
+    }
+};
+
+struct FixedADC
+{
+    void begin(uint8_t CS_pin) {}
+
+    int analogRead(uint8_t channel)
+    {
+        return 2048;
+    }
+
+    int maxValue()
+    {
+        return 4095;
+    }
+};
+
+struct FixedPot
+{
+    void begin(uint8_t CS_pin) {}
+    void setWiper(uint8_t value) {}
+};
+
+// Keeps the snapshots in memory, rtc_state being restored on boot when set
+Interface::PersistedState rtc_state;
+bool rtc_state_is_set = false;
+unsigned int rtc_saves = 0;
+
+struct MemoryStore
+{
+    MemoryStore(const char *path) {}
+
+    void save_to_rtc(const Interface::PersistedState &state)
+    {
+        rtc_state = state;
+        rtc_saves++;
+    }
+
+    void save_to_flash(const Interface::PersistedState &state) {}
+
+    Snapshot::Source load(Interface::PersistedState &state)
+    {
+        if (!rtc_state_is_set)
+        {
+            return Snapshot::Source::NONE;
+        }
+        state = rtc_state;
+        return Snapshot::Source::RTC;
+    }
+};
+
+struct NoAccountingStore
+{
+    NoAccountingStore(const char *path) {}
+
+    void save_to_flash(const Interface::PersistedAccounting &accounting) {}
+
+    bool load_from_flash(Interface::PersistedAccounting &accounting)
+    {
+        return false;
+    }
+};
+
+typedef Interface::Interface<RecordingClient, FixedADC, FixedPot, MemoryStore, NoAccountingStore> TestInterface;
+
+// A sentence with GT1 at 32.0 and GT2_heatpump at -5.0 degrees Celsius, the compressor running
+std::string make_sentence()
+{
+    int items[IVT490_NO_OF_ITEMS_IN_SENTENCE] = {};
+    items[1] = 320;
+    items[2] = -50;
+    items[3] = 480;
+    items[4] = 500;
+    items[13] = 1;
+    items[22] = 320;
+
+    std::string sentence;
+    for (int item = 0; item < IVT490_NO_OF_ITEMS_IN_SENTENCE; item++)
+    {
+        sentence += (item ? ";" : "") + std::to_string(items[item]);
+    }
+    return sentence;
+}
+
+void setUp(void)
+{
+    now = 1000;
+    relay_writes.clear();
+    rtc_state_is_set = false;
+    rtc_saves = 0;
+}
+
+void tearDown(void) {}
+
+void test_messages_are_dispatched_by_topic(void)
+{
+    RecordingClient client;
+    TestInterface ivt490(client, virtual_clock, write_relay);
+    ivt490.begin("ivt490");
+    ivt490.subscribe();
+
+    TEST_ASSERT_EQUAL(5, client.subscriptions.size());
+    TEST_ASSERT_EQUAL_STRING("ivt490/controller/set/feed_temperature_target", client.subscriptions[0].c_str());
+
+    // The payload is not null terminated
+    ivt490.handle_message("ivt490/controller/set/feed_temperature_target", "35.5garbage", 4);
+    TEST_ASSERT_EQUAL_FLOAT(35.5, ivt490.get_controller().get_feed_temperature_target());
+    TEST_ASSERT_TRUE(ivt490.get_controller().feed_temperature_target_is_valid());
+
+    // Not parsed as a float
+    ivt490.handle_message("ivt490/controller/set/outdoor_temperature_offset", "abc", 3);
+    TEST_ASSERT_FALSE(ivt490.get_controller().outdoor_temperature_offset_is_valid());
+
+    ivt490.handle_message("ivt490/controller/feedback/indoor_temperature", "21", 2);
+    TEST_ASSERT_EQUAL_FLOAT(21, ivt490.get_controller().get_indoor_temperature());
+}
+
+void test_sentence_enables_publishing(void)
+{
+    RecordingClient client;
+    TestInterface ivt490(client, virtual_clock, write_relay);
+    ivt490.begin("ivt490");
+
+    // Nothing to publish before the first sentence
+    TEST_ASSERT_TRUE(ivt490.publish_chunk());
+    TEST_ASSERT_EQUAL(0, client.published.size());
+
+    auto sentence = make_sentence();
+    ivt490.handle_IVT490_sentence(sentence.c_str());
+
+    TEST_ASSERT_EQUAL(1, client.published.size());
+    TEST_ASSERT_EQUAL_STRING("ivt490/state/raw", client.published[0].first.c_str());
+    TEST_ASSERT_EQUAL_STRING(sentence.c_str(), client.published[0].second.c_str());
+    TEST_ASSERT_TRUE(ivt490.serial_connection_is_initialized());
+    TEST_ASSERT_EQUAL_FLOAT(32, ivt490.get_state().GT1);
+    TEST_ASSERT_EQUAL(1, rtc_saves);
+
+    // An incomplete sentence is published as is, but not parsed
+    ivt490.handle_IVT490_sentence("1;2;3");
+    TEST_ASSERT_EQUAL(2, client.published.size());
+    TEST_ASSERT_EQUAL(1, rtc_saves);
+}
+
+void test_publishing_is_split_in_chunks(void)
+{
+    RecordingClient client;
+    TestInterface ivt490(client, virtual_clock, write_relay);
+    ivt490.begin("ivt490");
+    ivt490.handle_IVT490_sentence(make_sentence().c_str());
+    client.published.clear();
+
+    unsigned int chunks = 0;
+    size_t published = 0;
+    bool done = false;
+    while (!done && chunks < 1000)
+    {
+        done = ivt490.publish_chunk();
+        chunks++;
+
+        // A blob or at most GENERAL_PUBLISH_CHUNK_SIZE individual topics at a time
+        TEST_ASSERT_LESS_OR_EQUAL(GENERAL_PUBLISH_CHUNK_SIZE, client.published.size() - published);
+        published = client.published.size();
+    }
+    TEST_ASSERT_TRUE(done);
+
+    // The blob of the state comes first, followed by its individual topics
+    TEST_ASSERT_EQUAL_STRING("ivt490/state", client.published[0].first.c_str());
+    TEST_ASSERT_EQUAL('{', client.published[0].second[0]);
+    TEST_ASSERT_EQUAL_STRING("ivt490/state/GT1", client.published[1].first.c_str());
+    TEST_ASSERT_EQUAL_STRING("32", client.published[1].second.c_str());
+
+    unsigned int blobs = 0;
+    for (auto &message : client.published)
+    {
+        blobs += message.first == "ivt490/state" || message.first == "ivt490/controller/state" ||
+                 message.first == "ivt490/accounting" || message.first == "ivt490/diagnostics";
+    }
+    TEST_ASSERT_EQUAL(4, blobs);
+    TEST_ASSERT_GREATER_THAN(blobs + IVT490::IVT490State_number_of_float_fields, client.published.size());
+}
+
+void test_warm_restart_restores_state(void)
+{
+    RecordingClient client;
+    {
+        TestInterface ivt490(client, virtual_clock, write_relay);
+        ivt490.begin("ivt490");
+        ivt490.handle_GT2_sample(-8);
+        ivt490.handle_message("ivt490/controller/set/indoor_temperature_target", "22", 2);
+        ivt490.control();
+        ivt490.save_before_restart();
+    }
+    rtc_state_is_set = true;
+    relay_writes.clear();
+
+    TestInterface ivt490(client, virtual_clock, write_relay);
+    ivt490.begin("ivt490");
+
+    TEST_ASSERT_TRUE(ivt490.get_snapshot_source() == Snapshot::Source::RTC);
+    TEST_ASSERT_EQUAL_FLOAT(-8, ivt490.get_state().GT2_sensor);
+    TEST_ASSERT_EQUAL_FLOAT(22, ivt490.get_controller().get_indoor_temperature_target());
+    TEST_ASSERT_FALSE(isnan(ivt490.get_last_control_value()));
+    TEST_ASSERT_EQUAL(1, relay_writes.size());
+
+    // A restored snapshot is as good a starting point as the first serial sentence, the state is skipped
+    client.published.clear();
+    TEST_ASSERT_FALSE(ivt490.publish_chunk());
+    TEST_ASSERT_EQUAL(0, client.published.size());
+    ivt490.publish_chunk();
+    TEST_ASSERT_EQUAL_STRING("ivt490/controller/state", client.published[0].first.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_messages_are_dispatched_by_topic);
+    RUN_TEST(test_sentence_enables_publishing);
+    RUN_TEST(test_publishing_is_split_in_chunks);
+    RUN_TEST(test_warm_restart_restores_state);
+    return UNITY_END();
+}
@@ -0,0 +1,245 @@
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+
+#include "Metrics.h"
+
+// Client and server over TCP on the loopback interface, with the interface of WiFiClient and WiFiServer
+// used by Metrics::Server. The room in the send buffer is limited to write_budget bytes per poll, making
+// the scrape span several polls.
+
+size_t write_budget = 0;
+
+class LoopbackClient
+{
+public:
+    LoopbackClient(int fd = -1)
+    {
+        this->fd = fd;
+    }
+
+    explicit operator bool() const
+    {
+        return this->fd >= 0;
+    }
+
+    bool connected()
+    {
+        char c;
+        auto length = recv(this->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        return length > 0 || (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    }
+
+    int available()
+    {
+        int length = 0;
+        ioctl(this->fd, FIONREAD, &length);
+        return length;
+    }
+
+    int read()
+    {
+        uint8_t c;
+        return recv(this->fd, &c, 1, MSG_DONTWAIT) == 1 ? c : -1;
+    }
+
+    int availableForWrite()
+    {
+        return write_budget;
+    }
+
+    size_t write(const uint8_t *data, size_t length)
+    {
+        auto written = send(this->fd, data, length, MSG_NOSIGNAL);
+        write_budget -= std::min(write_budget, length);
+        return written < 0 ? 0 : written;
+    }
+
+    void stop()
+    {
+        if (this->fd >= 0)
+        {
+            close(this->fd);
+        }
+        this->fd = -1;
+    }
+
+private:
+    int fd;
+};
+
+class LoopbackServer
+{
+public:
+    static uint16_t bound_port;
+
+    LoopbackServer(uint16_t port)
+    {
+        this->port = port;
+    }
+
+    void begin()
+    {
+        this->fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(this->port);
+        bind(this->fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+        listen(this->fd, 1);
+        fcntl(this->fd, F_SETFL, O_NONBLOCK);
+
+        socklen_t length = sizeof(address);
+        getsockname(this->fd, reinterpret_cast<sockaddr *>(&address), &length);
+        bound_port = ntohs(address.sin_port);
+    }
+
+    LoopbackClient accept()
+    {
+        return LoopbackClient(::accept(this->fd, nullptr, nullptr));
+    }
+
+private:
+    uint16_t port;
+    int fd = -1;
+};
+
+uint16_t LoopbackServer::bound_port = 0;
+
+int format_test_metric(unsigned int index, char *buffer, size_t size)
+{
+    switch (index)
+    {
+    case 0:
+        return Metrics::format(buffer, size, "test_", "GT1", "gauge", 21.5);
+    case 1:
+        return Metrics::format(buffer, size, "test_", "compressor_starts_total", "counter", 12);
+    case 2:
+        return Metrics::format(buffer, size, "test_", "feed_temperature_target", "gauge", NAN);
+    default:
+        return -1;
+    }
+}
+
+const char *EXPECTED_METRICS =
+    "# TYPE test_GT1 gauge\n"
+    "test_GT1 21.5\n"
+    "# TYPE test_compressor_starts_total counter\n"
+    "test_compressor_starts_total 12\n"
+    "# TYPE test_feed_temperature_target gauge\n"
+    "test_feed_temperature_target NaN\n";
+
+// Sends request to the server and returns the full response, polling the server every virtual millisecond
+std::string scrape(Metrics::Server<LoopbackServer, LoopbackClient> &server, const char *request, unsigned long &now, unsigned int &polls)
+{
+    auto fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(LoopbackServer::bound_port);
+    connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    send(fd, request, strlen(request), 0);
+
+    // Until the connection has been accepted, served and closed
+    polls = 0;
+    bool busy = false;
+    for (unsigned int i = 0; i < 10000; i++, now++)
+    {
+        write_budget = 200;
+        auto idle = server.poll(now);
+        polls++;
+
+        if (!idle)
+        {
+            busy = true;
+        }
+        else if (busy)
+        {
+            break;
+        }
+    }
+
+    std::string response;
+    char buffer[256];
+    ssize_t length;
+    while ((length = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+    {
+        response.append(buffer, length);
+    }
+    close(fd);
+
+    return response;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_format_exposition(void)
+{
+    char buffer[160];
+
+    TEST_ASSERT_EQUAL(41, Metrics::format(buffer, sizeof(buffer), "ivt490_", "GT1", "gauge", -5.25));
+    TEST_ASSERT_EQUAL_STRING("# TYPE ivt490_GT1 gauge\nivt490_GT1 -5.25\n", buffer);
+
+    Metrics::format(buffer, sizeof(buffer), "ivt490_", "compressor_starts_total", "counter", 123456789);
+    TEST_ASSERT_EQUAL_STRING("# TYPE ivt490_compressor_starts_total counter\nivt490_compressor_starts_total 123456789\n", buffer);
+
+    Metrics::format(buffer, sizeof(buffer), "", "offset", "gauge", NAN);
+    TEST_ASSERT_EQUAL_STRING("# TYPE offset gauge\noffset NaN\n", buffer);
+
+    Metrics::format(buffer, sizeof(buffer), "", "limit", "gauge", -INFINITY);
+    TEST_ASSERT_EQUAL_STRING("# TYPE limit gauge\nlimit -Inf\n", buffer);
+}
+
+void test_scrape_over_loopback(void)
+{
+    Metrics::Server<LoopbackServer, LoopbackClient> server(0, format_test_metric);
+    server.begin();
+
+    unsigned long now = 0;
+    unsigned int polls = 0;
+    auto response = scrape(server, "GET /metrics HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n", now, polls);
+
+    std::string expected = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n";
+    expected += EXPECTED_METRICS;
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), response.c_str());
+
+    // The send buffer only had room for two lines per poll
+    TEST_ASSERT_GREATER_THAN(3, polls);
+
+    TEST_ASSERT_EQUAL(1, server.get_scrapes());
+    TEST_ASSERT_EQUAL(response.size(), server.get_last_bytes());
+    TEST_ASSERT_EQUAL(response.size(), server.get_bytes_served());
+    TEST_ASSERT_GREATER_THAN(0, server.get_last_duration());
+}
+
+void test_unknown_path_is_not_found(void)
+{
+    Metrics::Server<LoopbackServer, LoopbackClient> server(0, format_test_metric);
+    server.begin();
+
+    unsigned long now = 0;
+    unsigned int polls = 0;
+    auto response = scrape(server, "GET / HTTP/1.1\r\n\r\n", now, polls);
+
+    TEST_ASSERT_EQUAL_STRING("HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\n", response.c_str());
+    TEST_ASSERT_EQUAL(0, server.get_scrapes());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_format_exposition);
+    RUN_TEST(test_scrape_over_loopback);
+    RUN_TEST(test_unknown_path_is_not_found);
+    return UNITY_END();
+}
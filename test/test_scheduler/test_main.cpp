@@ -0,0 +1,216 @@
+#include <unity.h>
+#include <ArduinoJson.h>
+
+#define IVT490_ADC_SAMPLING_MIN_INTERVAL 1000
+#define IVT490_ADC_FILTER_TIME_CONSTANT 300000
+#include "config_defaults.h"
+
+#include "Scheduler.h"
+
+// Virtual clock, advanced explicitly by the tests
+unsigned long now = 0;
+
+unsigned long virtual_clock()
+{
+    return now;
+}
+
+// Order in which the tasks were run, as a string of task identifiers
+char order[32];
+int order_length = 0;
+
+void record(char id)
+{
+    order[order_length++] = id;
+    order[order_length] = '\0';
+}
+
+int chunks_left = 0;
+
+void setUp(void)
+{
+    now = 0;
+    order[0] = '\0';
+    order_length = 0;
+    chunks_left = 0;
+}
+
+void tearDown(void) {}
+
+void test_tasks_are_first_due_after_one_period(void)
+{
+    Scheduler::Scheduler<2> scheduler(virtual_clock);
+    scheduler.add("a", 100, 0, []()
+                  { record('a'); return true; });
+
+    for (now = 0; now < 100; now++)
+    {
+        scheduler.tick();
+    }
+    TEST_ASSERT_EQUAL_STRING("", order);
+
+    scheduler.tick();
+    TEST_ASSERT_EQUAL_STRING("a", order);
+    TEST_ASSERT_EQUAL(1, scheduler.get_task(0).runs);
+}
+
+void test_highest_priority_runs_first(void)
+{
+    Scheduler::Scheduler<3> scheduler(virtual_clock);
+    scheduler.add("low", 50, 2, []()
+                  { record('l'); return true; });
+    scheduler.add("high", 100, 0, []()
+                  { record('h'); return true; });
+    scheduler.add("middle", 100, 1, []()
+                  { record('m'); return true; });
+
+    // All are due, the low priority task since long
+    now = 100;
+    scheduler.tick();
+    scheduler.tick();
+    scheduler.tick();
+    scheduler.tick();
+    TEST_ASSERT_EQUAL_STRING("hml", order);
+}
+
+void test_chunked_task_yields_to_higher_priority(void)
+{
+    Scheduler::Scheduler<2> scheduler(virtual_clock);
+    scheduler.add("publish", 100, 1, []()
+                  { record('p'); return --chunks_left == 0; });
+    scheduler.add("control", 10, 0, []()
+                  { record('c'); return true; });
+
+    chunks_left = 3;
+    now = 100;
+    scheduler.tick(); // control, due since 90
+    scheduler.tick(); // publish, first chunk
+    now = 110;
+    scheduler.tick(); // control preempts the remaining chunks
+    scheduler.tick();
+    scheduler.tick();
+    scheduler.tick(); // nothing due
+
+    TEST_ASSERT_EQUAL_STRING("cpcpp", order);
+
+    auto &publish = scheduler.get_task(0);
+    TEST_ASSERT_EQUAL(1, publish.runs);
+    TEST_ASSERT_EQUAL(3, publish.chunks);
+    TEST_ASSERT_EQUAL(0, publish.deadline_misses);
+}
+
+void test_lateness_and_jitter_histograms(void)
+{
+    Scheduler::Scheduler<1> scheduler(virtual_clock);
+    scheduler.add("a", 100, 0, []()
+                  { return true; });
+
+    // Started 0, 7, 7 and 1 milliseconds late
+    const unsigned long starts[] = {100, 207, 307, 401};
+    for (auto start : starts)
+    {
+        now = start;
+        scheduler.tick();
+    }
+
+    auto &task = scheduler.get_task(0);
+    TEST_ASSERT_EQUAL(4, task.runs);
+
+    // Bounds are 0, 1, 2, 5, 10, ...
+    TEST_ASSERT_EQUAL(1, task.lateness.get_count(0));
+    TEST_ASSERT_EQUAL(1, task.lateness.get_count(1));
+    TEST_ASSERT_EQUAL(2, task.lateness.get_count(4));
+    TEST_ASSERT_EQUAL(7, task.lateness.get_maximum());
+
+    // Lateness changed by 7, 0 and 6 milliseconds
+    TEST_ASSERT_EQUAL(1, task.jitter.get_count(0));
+    TEST_ASSERT_EQUAL(2, task.jitter.get_count(4));
+    TEST_ASSERT_EQUAL(7, task.jitter.get_maximum());
+}
+
+void test_overrun_skips_missed_periods(void)
+{
+    Scheduler::Scheduler<1> scheduler(virtual_clock);
+    scheduler.add("slow", 100, 0, []()
+                  { now += 250; return true; });
+
+    now = 100;
+    scheduler.tick(); // Completes at 350, missing the periods due at 200 and 300
+
+    auto &task = scheduler.get_task(0);
+    TEST_ASSERT_EQUAL(1, task.deadline_misses);
+    TEST_ASSERT_EQUAL(400, task.due);
+}
+
+void test_adding_too_many_tasks_fails(void)
+{
+    Scheduler::Scheduler<1> scheduler(virtual_clock);
+    TEST_ASSERT_TRUE(scheduler.add("a", 100, 0, []()
+                                   { return true; }));
+    TEST_ASSERT_FALSE(scheduler.add("b", 100, 0, []()
+                                    { return true; }));
+    TEST_ASSERT_EQUAL(1, scheduler.get_number_of_tasks());
+}
+
+// Size of a slot of ArduinoJson on the ESP8266, where pointers are 32 bits
+const size_t TARGET_SLOT_SIZE = 16;
+
+// The top level members of serialize_diagnostics in src/main.cpp besides the scheduler, all options enabled
+const char *DIAGNOSTICS_MEMBERS[] = {
+    "uptime", "snapshot_source", "startup_first_output", "startup_first_correct_output", "anomaly_events",
+    "adc_sampling_interval", "adc_sampling_rate", "individual_topics_published", "individual_topics_skipped",
+    "heap_free", "heap_min_free", "heap_max_free_block", "heap_min_max_free_block", "heap_fragmentation",
+    "metrics_scrapes", "metrics_bytes_served", "metrics_last_scrape_bytes", "metrics_last_scrape_duration",
+    "allocations_after_setup", "allocations_since_last_publish"};
+
+// As many slots as GENERAL_JSON_DOCUMENT_SIZE holds on the target
+StaticJsonDocument<GENERAL_JSON_DOCUMENT_SIZE / TARGET_SLOT_SIZE * JSON_OBJECT_SIZE(1)> diagnostics;
+
+void test_diagnostics_fit_json_document(void)
+{
+    // As many tasks as in src/main.cpp, all with statistics
+    Scheduler::Scheduler<5> scheduler(virtual_clock);
+    const char *names[] = {"control", "adc", "publish", "metrics", "snapshot"};
+    for (unsigned int i = 0; i < 5; i++)
+    {
+        scheduler.add(names[i], 10, i, []()
+                      { return true; });
+    }
+    for (now = 10; now < 1000; now += 7)
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            scheduler.tick();
+        }
+    }
+
+    // The scheduler comes before the metrics and allocations, whatever overflows is lost from there on
+    diagnostics.clear();
+    for (int i = 0; i < 14; i++)
+    {
+        diagnostics[DIAGNOSTICS_MEMBERS[i]] = 4294967295UL;
+    }
+    scheduler.serialize(diagnostics.createNestedObject("scheduler"));
+    for (int i = 14; i < 20; i++)
+    {
+        diagnostics[DIAGNOSTICS_MEMBERS[i]] = 4294967295UL;
+    }
+
+    TEST_ASSERT_FALSE(diagnostics.overflowed());
+    TEST_ASSERT_TRUE(diagnostics.containsKey("allocations_since_last_publish"));
+    TEST_ASSERT_EQUAL(12, diagnostics["scheduler"]["snapshot"]["jitter"].size());
+    TEST_ASSERT_TRUE(measureJson(diagnostics) < GENERAL_MQTT_PAYLOAD_BUFFER_SIZE);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_tasks_are_first_due_after_one_period);
+    RUN_TEST(test_highest_priority_runs_first);
+    RUN_TEST(test_chunked_task_yields_to_higher_priority);
+    RUN_TEST(test_lateness_and_jitter_histograms);
+    RUN_TEST(test_overrun_skips_missed_periods);
+    RUN_TEST(test_adding_too_many_tasks_fails);
+    RUN_TEST(test_diagnostics_fit_json_document);
+    return UNITY_END();
+}
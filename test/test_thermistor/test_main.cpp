@@ -0,0 +1,99 @@
+#include <unity.h>
+
+#include "Thermistor.h"
+
+// Stand-ins for MCP3208 and MCP41_Simple
+struct FakeADC
+{
+    int value = 0;
+
+    void begin(uint8_t CS_pin) {}
+
+    int analogRead(uint8_t channel)
+    {
+        return this->value;
+    }
+
+    int maxValue()
+    {
+        return 4095;
+    }
+};
+
+struct FakePot
+{
+    int wiper = -1;
+    int writes = 0;
+
+    void begin(uint8_t CS_pin) {}
+
+    void setWiper(uint8_t value)
+    {
+        this->wiper = value;
+        this->writes++;
+    }
+};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_NTC_tables_are_inverse(void)
+{
+    for (float temperature = -40; temperature <= 90; temperature += 2.5)
+    {
+        TEST_ASSERT_FLOAT_WITHIN(0.01, temperature, Thermistor::NTC_interpolate_temperature(Thermistor::NTC_interpolate_resistance(temperature)));
+    }
+
+    // Clamped to the ends of the table
+    TEST_ASSERT_EQUAL_FLOAT(-40, Thermistor::NTC_interpolate_temperature(1e9));
+    TEST_ASSERT_EQUAL_FLOAT(90, Thermistor::NTC_interpolate_temperature(0));
+}
+
+void test_reader(void)
+{
+    Thermistor::Reader<FakeADC, 10000> reader(15, 0);
+
+    // Halfway, the NTC equals R_0
+    reader.get_adc().value = 2048;
+    TEST_ASSERT_FLOAT_WITHIN(0.05, Thermistor::NTC_interpolate_temperature(10000), reader.read());
+
+    // Open sensor
+    reader.get_adc().value = 0;
+    TEST_ASSERT_EQUAL_FLOAT(-40, reader.read());
+}
+
+void test_emulator_writes_wiper(void)
+{
+    Thermistor::Emulator<FakePot, 8, 100000> emulator(2);
+    TEST_ASSERT_EQUAL(1, emulator.get_pot().writes);
+
+    emulator.set_target_value(-10);
+    auto cold = emulator.get_wiper_value();
+    emulator.set_target_value(10);
+    auto warm = emulator.get_wiper_value();
+
+    TEST_ASSERT_EQUAL(warm, emulator.get_pot().wiper);
+    TEST_ASSERT_TRUE(cold > warm);
+}
+
+void test_emulator_correction(void)
+{
+    Thermistor::Emulator<FakePot, 8, 100000> emulator(2);
+    emulator.set_target_value(0);
+
+    // The heatpump reads a warmer temperature than emulated, so more resistance is needed
+    emulator.adjust_correction(1);
+    TEST_ASSERT_TRUE(emulator.get_resistance_offset() > 0);
+    TEST_ASSERT_FLOAT_WITHIN(1, Thermistor::NTC_interpolate_resistance(0) - Thermistor::NTC_interpolate_resistance(1), emulator.get_resistance_offset());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_NTC_tables_are_inverse);
+    RUN_TEST(test_reader);
+    RUN_TEST(test_emulator_writes_wiper);
+    RUN_TEST(test_emulator_correction);
+    return UNITY_END();
+}
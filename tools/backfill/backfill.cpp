@@ -0,0 +1,464 @@
+// Offline backfill of archived {MQTT_BASE_TOPIC}/state/raw logs into columnar files, see README.md
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "IVT490State.h"
+
+using namespace IVT490;
+
+namespace
+{
+    // Logs are processed in batches of about this size, bounding the memory used for the columns
+    const size_t BATCH_SIZE = 256 << 20;
+
+    // Bitmask of the positions of item (';') and sentence ('\n') delimiters in a block of input
+#if defined(__AVX2__)
+    const size_t BLOCK_SIZE = 32;
+
+    inline uint64_t delimiter_mask(const char *p)
+    {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        auto semicolons = _mm256_cmpeq_epi8(block, _mm256_set1_epi8(';'));
+        auto newlines = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n'));
+        return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(semicolons, newlines));
+    }
+#elif defined(__SSE2__)
+    const size_t BLOCK_SIZE = 16;
+
+    inline uint64_t delimiter_mask(const char *p)
+    {
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        auto semicolons = _mm_cmpeq_epi8(block, _mm_set1_epi8(';'));
+        auto newlines = _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'));
+        return (uint32_t)_mm_movemask_epi8(_mm_or_si128(semicolons, newlines));
+    }
+#else
+    const size_t BLOCK_SIZE = 8;
+
+    inline uint64_t delimiter_mask(const char *p)
+    {
+        uint64_t mask = 0;
+        for (size_t i = 0; i < BLOCK_SIZE; i++)
+        {
+            mask |= (uint64_t)(p[i] == ';' || p[i] == '\n') << i;
+        }
+        return mask;
+    }
+#endif
+
+    // Items are integers (tenths of degrees or flags), anything after the digits is ignored
+    inline int32_t parse_item(const char *p, const char *end)
+    {
+        while (p < end && *p == ' ')
+        {
+            p++;
+        }
+
+        bool negative = p < end && *p == '-';
+        p += negative;
+
+        int32_t value = 0;
+        while (p < end && (unsigned)(*p - '0') < 10)
+        {
+            value = value * 10 + (*p++ - '0');
+        }
+
+        return negative ? -value : value;
+    }
+
+    struct Columns
+    {
+        std::vector<std::vector<float>> floats;
+        std::vector<std::vector<uint8_t>> bools;
+        size_t sentences = 0;
+        size_t malformed = 0;
+
+        Columns() : floats(IVT490State_number_of_float_fields), bools(IVT490State_number_of_bool_fields) {}
+
+        void append(const int32_t *items)
+        {
+            for (int i = 0; i < IVT490State_number_of_float_fields; i++)
+            {
+                auto &field = IVT490State_float_fields[i];
+                if (field.item >= 0)
+                {
+                    this->floats[i].push_back(field.scale * items[field.item]);
+                }
+            }
+
+            for (int i = 0; i < IVT490State_number_of_bool_fields; i++)
+            {
+                this->bools[i].push_back(items[IVT490State_bool_fields[i].item] != 0);
+            }
+
+            this->sentences++;
+        }
+
+        void clear()
+        {
+            for (auto &column : this->floats)
+            {
+                column.clear();
+            }
+            for (auto &column : this->bools)
+            {
+                column.clear();
+            }
+        }
+    };
+
+    // Parses all complete sentences in [begin, end), with the same acceptance as parse_IVT490 on the device:
+    // at least IVT490_NO_OF_ITEMS_IN_SENTENCE items, where any items beyond that are ignored
+    void parse_range(const char *begin, const char *end, Columns &columns)
+    {
+        int32_t items[IVT490_NO_OF_ITEMS_IN_SENTENCE];
+        int item = 0;
+        const char *item_begin = begin;
+
+        auto delimiter = [&](const char *at)
+        {
+            if (item < IVT490_NO_OF_ITEMS_IN_SENTENCE)
+            {
+                items[item] = parse_item(item_begin, at);
+            }
+            item++;
+
+            if (at == end || *at == '\n')
+            {
+                if (item >= IVT490_NO_OF_ITEMS_IN_SENTENCE)
+                {
+                    columns.append(items);
+                }
+                else if (item > 1 || at - item_begin > 1)
+                {
+                    columns.malformed++;
+                }
+                item = 0;
+            }
+
+            item_begin = at + 1;
+        };
+
+        auto p = begin;
+        for (; p + BLOCK_SIZE <= end; p += BLOCK_SIZE)
+        {
+            auto mask = delimiter_mask(p);
+            while (mask)
+            {
+                delimiter(p + __builtin_ctzll(mask));
+                mask &= mask - 1;
+            }
+        }
+
+        for (; p < end; p++)
+        {
+            if (*p == ';' || *p == '\n')
+            {
+                delimiter(p);
+            }
+        }
+
+        // Last sentence without a trailing newline
+        if (item_begin < end)
+        {
+            delimiter(end);
+        }
+    }
+
+    // Start of the sentence following position p
+    const char *next_sentence(const char *p, const char *end)
+    {
+        if (p >= end)
+        {
+            return end;
+        }
+
+        auto newline = static_cast<const char *>(memchr(p, '\n', end - p));
+        return newline ? newline + 1 : end;
+    }
+
+    class Output
+    {
+    public:
+        Output(const std::string &directory)
+        {
+            for (int i = 0; i < IVT490State_number_of_float_fields; i++)
+            {
+                auto &field = IVT490State_float_fields[i];
+                this->floats.push_back(field.item >= 0 ? this->open(directory, field.name, ".f32") : nullptr);
+            }
+
+            for (int i = 0; i < IVT490State_number_of_bool_fields; i++)
+            {
+                this->bools.push_back(this->open(directory, IVT490State_bool_fields[i].name, ".u8"));
+            }
+        }
+
+        ~Output()
+        {
+            for (auto file : this->floats)
+            {
+                if (file)
+                {
+                    fclose(file);
+                }
+            }
+            for (auto file : this->bools)
+            {
+                fclose(file);
+            }
+        }
+
+        void write(const Columns &columns)
+        {
+            for (size_t i = 0; i < this->floats.size(); i++)
+            {
+                if (this->floats[i])
+                {
+                    fwrite(columns.floats[i].data(), sizeof(float), columns.floats[i].size(), this->floats[i]);
+                }
+            }
+
+            for (size_t i = 0; i < this->bools.size(); i++)
+            {
+                fwrite(columns.bools[i].data(), sizeof(uint8_t), columns.bools[i].size(), this->bools[i]);
+            }
+        }
+
+    private:
+        FILE *open(const std::string &directory, const char *name, const char *extension)
+        {
+            auto path = directory + "/" + name + extension;
+            auto file = fopen(path.c_str(), "wb");
+            if (!file)
+            {
+                fprintf(stderr, "Failed opening %s for writing\n", path.c_str());
+                exit(1);
+            }
+            return file;
+        }
+
+        std::vector<FILE *> floats;
+        std::vector<FILE *> bools;
+    };
+
+    struct Statistics
+    {
+        size_t bytes = 0;
+        size_t sentences = 0;
+        size_t malformed = 0;
+    };
+
+    void backfill(const char *path, unsigned int threads, Output *output, Statistics &statistics)
+    {
+        auto fd = open(path, O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) < 0)
+        {
+            fprintf(stderr, "Failed opening %s\n", path);
+            exit(1);
+        }
+
+        if (info.st_size == 0)
+        {
+            close(fd);
+            return;
+        }
+
+        auto data = static_cast<const char *>(mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+        if (data == MAP_FAILED)
+        {
+            fprintf(stderr, "Failed mapping %s\n", path);
+            exit(1);
+        }
+        madvise(const_cast<char *>(data), info.st_size, MADV_SEQUENTIAL);
+
+        const char *end = data + info.st_size;
+        std::vector<Columns> columns(threads);
+
+        for (auto batch_begin = data; batch_begin < end;)
+        {
+            auto batch_end = next_sentence(batch_begin + std::min(BATCH_SIZE, (size_t)(end - batch_begin)) - 1, end);
+
+            // Split the batch on sentence boundaries, one part per thread
+            std::vector<const char *> bounds(threads + 1, batch_end);
+            bounds[0] = batch_begin;
+            for (unsigned int t = 1; t < threads; t++)
+            {
+                bounds[t] = std::max(bounds[t - 1], next_sentence(batch_begin + (batch_end - batch_begin) * t / threads, batch_end));
+            }
+
+            std::vector<std::thread> workers;
+            for (unsigned int t = 0; t < threads; t++)
+            {
+                workers.emplace_back([&, t]()
+                                     { parse_range(bounds[t], bounds[t + 1], columns[t]); });
+            }
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+
+            // Written in order, keeping the sentences in the order of the log
+            for (auto &part : columns)
+            {
+                if (output)
+                {
+                    output->write(part);
+                }
+                part.clear();
+            }
+
+            batch_begin = batch_end;
+        }
+
+        for (auto &part : columns)
+        {
+            statistics.sentences += part.sentences;
+            statistics.malformed += part.malformed;
+        }
+        statistics.bytes += info.st_size;
+
+        munmap(const_cast<char *>(data), info.st_size);
+        close(fd);
+    }
+
+    // Writes a synthetic log of about size bytes, in the format output by the heatpump, to a new file in
+    // directory. Returns the path of the file, which is created such that no existing file is overwritten.
+    std::string generate(const char *directory, size_t size)
+    {
+        auto path = std::string(directory) + "/ivt490-backfill-bench-XXXXXX";
+        auto fd = mkstemp(&path[0]);
+        auto file = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+        if (!file)
+        {
+            fprintf(stderr, "Failed creating a file in %s\n", directory);
+            exit(1);
+        }
+
+        uint32_t seed = 1;
+        auto random = [&](int range)
+        {
+            seed = seed * 1664525 + 1013904223;
+            return (int)((seed >> 8) % range);
+        };
+
+        char line[256];
+        for (size_t written = 0; written < size;)
+        {
+            auto length = snprintf(line, sizeof(line),
+                                   "0;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;0;0;0;0;%d;0;0;0\n",
+                                   200 + random(300), -250 + random(400), 450 + random(100), 450 + random(100), 300 + random(200),
+                                   200 + random(30), 500 + random(600), random(500), random(2), random(2), random(2), random(2),
+                                   random(2), random(2), random(2), random(2), random(2), random(2), random(2), 200, 220,
+                                   250 + random(300), 550, 400, 420, 520, 200, 300 + random(100), random(1000));
+            fwrite(line, 1, length, file);
+            written += length;
+        }
+
+        fclose(file);
+        return path;
+    }
+
+    void usage(const char *program)
+    {
+        fprintf(stderr,
+                "Usage: %s [--threads N] [--output DIRECTORY] FILE...\n"
+                "       %s --bench MEGABYTES [--threads N] [--output DIRECTORY] [--bench-dir DIRECTORY]\n",
+                program, program);
+        exit(1);
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    const char *directory = nullptr;
+    size_t bench_size = 0;
+    const char *bench_directory = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    std::string bench_file;
+    std::vector<const char *> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--threads" && i + 1 < argc)
+        {
+            threads = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--output" && i + 1 < argc)
+        {
+            directory = argv[++i];
+        }
+        else if (arg == "--bench" && i + 1 < argc)
+        {
+            bench_size = (size_t)atoll(argv[++i]) << 20;
+        }
+        else if (arg == "--bench-dir" && i + 1 < argc)
+        {
+            bench_directory = argv[++i];
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            usage(argv[0]);
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (bench_size > 0)
+    {
+        fprintf(stderr, "Generating %zu MB of synthetic sentences in %s...\n", bench_size >> 20, bench_directory);
+        bench_file = generate(bench_directory, bench_size);
+        files.push_back(bench_file.c_str());
+    }
+
+    if (files.empty())
+    {
+        usage(argv[0]);
+    }
+
+    Output *output = directory ? new Output(directory) : nullptr;
+    Statistics statistics;
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto file : files)
+    {
+        backfill(file, threads, output, statistics);
+    }
+    delete output;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%zu bytes, %zu sentences (%zu malformed) in %.3f s using %u threads\n",
+           statistics.bytes, statistics.sentences, statistics.malformed, seconds, threads);
+    printf("%.3f GB/s, %.0f sentences/s\n", statistics.bytes / seconds / 1e9, statistics.sentences / seconds);
+
+    // Only ever the file created by generate()
+    if (!bench_file.empty())
+    {
+        unlink(bench_file.c_str());
+    }
+
+    return 0;
+}
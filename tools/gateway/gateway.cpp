@@ -0,0 +1,1050 @@
+// Aggregation gateway for fleets of IVT490 interfaces, see README.md
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "IVT490State.h"
+
+using namespace IVT490;
+
+namespace
+{
+    const char *RAW_SUFFIX = "/state/raw";
+    const char *STATE_SUFFIX = "/state";
+
+    // Rows of a unit are buffered until this many, then written as one block
+    const size_t BLOCK_ROWS = 256;
+
+    // Buffered rows are written at least this often, regardless of the number of rows
+    const auto FLUSH_PERIOD = std::chrono::seconds(60);
+
+    // Messages queued per worker before the source is held back
+    const size_t QUEUE_CAPACITY = 1 << 16;
+
+    enum Kind
+    {
+        RAW,
+        STATE,
+        NUMBER_OF_KINDS
+    };
+
+    struct Message
+    {
+        std::string unit; // Topic without the suffix, i.e. the MQTT_BASE_TOPIC of the unit
+        Kind kind;
+        std::string payload;
+        int64_t time; // milliseconds
+    };
+
+    // Splits a topic into the unit and the kind of message, returns false for any other topic
+    bool classify(const char *topic, size_t length, Message &message)
+    {
+        auto ends_with = [&](const char *suffix)
+        {
+            auto suffix_length = strlen(suffix);
+            return length > suffix_length && memcmp(topic + length - suffix_length, suffix, suffix_length) == 0;
+        };
+
+        if (ends_with(RAW_SUFFIX))
+        {
+            message.unit.assign(topic, length - strlen(RAW_SUFFIX));
+            message.kind = RAW;
+            return true;
+        }
+
+        if (ends_with(STATE_SUFFIX))
+        {
+            message.unit.assign(topic, length - strlen(STATE_SUFFIX));
+            message.kind = STATE;
+            return true;
+        }
+
+        return false;
+    }
+
+    inline uint64_t fnv1a(const std::string &data)
+    {
+        uint64_t hash = 0xcbf29ce484222325;
+        for (unsigned char c : data)
+        {
+            hash = (hash ^ c) * 0x100000001b3;
+        }
+        return hash;
+    }
+
+    // Sets the fields found in a JSON blob as published on {MQTT_BASE_TOPIC}/state, returns false if none
+    // were found. The blob is flat, so looking up each key is enough.
+    bool parse_state(const std::string &payload, IVT490State &state)
+    {
+        static const auto keys = []()
+        {
+            std::vector<std::string> keys;
+            for (int i = 0; i < IVT490State_number_of_float_fields; i++)
+            {
+                keys.push_back(std::string("\"") + IVT490State_float_fields[i].name + "\":");
+            }
+            for (int i = 0; i < IVT490State_number_of_bool_fields; i++)
+            {
+                keys.push_back(std::string("\"") + IVT490State_bool_fields[i].name + "\":");
+            }
+            return keys;
+        }();
+
+        int found = 0;
+
+        for (int i = 0; i < IVT490State_number_of_float_fields; i++)
+        {
+            auto &field = IVT490State_float_fields[i];
+            auto &key = keys[i];
+            auto at = strstr(payload.c_str(), key.c_str());
+            if (at)
+            {
+                auto value = at + key.size();
+                state.*field.member = strncmp(value, "null", 4) == 0 ? NAN : strtof(value, nullptr);
+                found++;
+            }
+        }
+
+        for (int i = 0; i < IVT490State_number_of_bool_fields; i++)
+        {
+            auto &field = IVT490State_bool_fields[i];
+            auto &key = keys[IVT490State_number_of_float_fields + i];
+            auto at = strstr(payload.c_str(), key.c_str());
+            if (at)
+            {
+                state.*field.member = strncmp(at + key.size(), "true", 4) == 0;
+                found++;
+            }
+        }
+
+        return found > 0;
+    }
+
+    bool equal(const IVT490State &a, const IVT490State &b)
+    {
+        for (int i = 0; i < IVT490State_number_of_float_fields; i++)
+        {
+            auto member = IVT490State_float_fields[i].member;
+            if (a.*member != b.*member && !(isnan(a.*member) && isnan(b.*member)))
+            {
+                return false;
+            }
+        }
+
+        for (int i = 0; i < IVT490State_number_of_bool_fields; i++)
+        {
+            auto member = IVT490State_bool_fields[i].member;
+            if (a.*member != b.*member)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Bounded queue between two stages of the pipeline. Producers are held back while it is full, the consumer
+    // takes everything queued at once, keeping the time the lock is held independent of the load.
+    template <typename T>
+    class Queue
+    {
+    public:
+        Queue(size_t capacity)
+        {
+            this->capacity = capacity;
+        }
+
+        void push(std::vector<T> &items)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->not_full.wait(lock, [&]()
+                                { return this->items.size() < this->capacity; });
+
+            std::move(items.begin(), items.end(), std::back_inserter(this->items));
+            items.clear();
+            this->not_empty.notify_one();
+        }
+
+        // Waits up to timeout for items, returns false once closed and drained
+        template <typename duration_t>
+        bool pop_all(std::vector<T> &items, duration_t timeout)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->not_empty.wait_for(lock, timeout, [&]()
+                                     { return !this->items.empty() || this->closed; });
+
+            items.clear();
+            std::swap(items, this->items);
+            this->not_full.notify_all();
+
+            return !items.empty() || !this->closed;
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->closed = true;
+            this->not_empty.notify_all();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        std::vector<T> items;
+        size_t capacity;
+        bool closed = false;
+    };
+
+    // Rows of one unit, column by column, in the order of the field tables
+    struct Block
+    {
+        std::string unit;
+        std::vector<int64_t> times;
+        std::vector<std::vector<float>> floats;
+        std::vector<std::vector<uint8_t>> bools;
+
+        Block() : floats(IVT490State_number_of_float_fields), bools(IVT490State_number_of_bool_fields) {}
+
+        size_t rows() const
+        {
+            return this->times.size();
+        }
+
+        void append(int64_t time, const IVT490State &state)
+        {
+            this->times.push_back(time);
+
+            for (int i = 0; i < IVT490State_number_of_float_fields; i++)
+            {
+                this->floats[i].push_back(state.*IVT490State_float_fields[i].member);
+            }
+
+            for (int i = 0; i < IVT490State_number_of_bool_fields; i++)
+            {
+                this->bools[i].push_back(state.*IVT490State_bool_fields[i].member);
+            }
+        }
+    };
+
+    // Header of each block in a unit file, followed by the time column (int64, milliseconds), the float
+    // columns, the bool columns (one byte per row) and padding up to a multiple of 8 bytes. All little-endian.
+    struct BlockHeader
+    {
+        uint32_t magic;
+        uint16_t float_columns;
+        uint16_t bool_columns;
+        uint32_t rows;
+        uint32_t size; // bytes, including the header and padding
+    };
+
+    const uint32_t BLOCK_MAGIC = 0x42545649; // "IVTB"
+
+    size_t block_size(size_t rows)
+    {
+        auto size = sizeof(BlockHeader) + rows * (sizeof(int64_t) + IVT490State_number_of_float_fields * sizeof(float) + IVT490State_number_of_bool_fields);
+        return (size + 7) & ~(size_t)7;
+    }
+
+    // Append-only file per unit, named after the unit topic with '/' replaced by '_'
+    class Storage
+    {
+    public:
+        Storage(const std::string &directory)
+        {
+            this->directory = directory;
+        }
+
+        std::string path(const std::string &unit) const
+        {
+            auto name = unit;
+            std::replace(name.begin(), name.end(), '/', '_');
+            return this->directory + "/" + name + ".ivt";
+        }
+
+        void write(const Block &block)
+        {
+            auto rows = block.rows();
+            this->buffer.assign(block_size(rows), 0);
+
+            BlockHeader header = {BLOCK_MAGIC, (uint16_t)IVT490State_number_of_float_fields, (uint16_t)IVT490State_number_of_bool_fields, (uint32_t)rows, (uint32_t)this->buffer.size()};
+            auto p = this->buffer.data();
+            p = std::copy_n(reinterpret_cast<const char *>(&header), sizeof(header), p);
+            p = std::copy_n(reinterpret_cast<const char *>(block.times.data()), rows * sizeof(int64_t), p);
+            for (auto &column : block.floats)
+            {
+                p = std::copy_n(reinterpret_cast<const char *>(column.data()), rows * sizeof(float), p);
+            }
+            for (auto &column : block.bools)
+            {
+                p = std::copy_n(reinterpret_cast<const char *>(column.data()), rows, p);
+            }
+
+            // A single write per block, such that a reader never sees a partial block from this process
+            auto path = this->path(block.unit);
+            auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (fd < 0 || ::write(fd, this->buffer.data(), this->buffer.size()) != (ssize_t)this->buffer.size())
+            {
+                fprintf(stderr, "Failed writing %s\n", path.c_str());
+                exit(1);
+            }
+            close(fd);
+
+            this->blocks++;
+            this->bytes += this->buffer.size();
+        }
+
+        size_t blocks = 0;
+        size_t bytes = 0;
+
+    private:
+        std::string directory;
+        std::vector<char> buffer;
+    };
+
+    // Calls handler for every block of a unit file, returns the number of rows or -1 if the file can not be read
+    // or is corrupt
+    long scan(const char *path, std::function<void(const BlockHeader &, const char *)> handler)
+    {
+        auto fd = open(path, O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) < 0)
+        {
+            return -1;
+        }
+
+        if (info.st_size == 0)
+        {
+            close(fd);
+            return 0;
+        }
+
+        auto data = static_cast<const char *>(mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+        close(fd);
+        if (data == MAP_FAILED)
+        {
+            return -1;
+        }
+
+        long rows = 0;
+        for (off_t offset = 0; offset < info.st_size;)
+        {
+            BlockHeader header;
+            if (info.st_size - offset < (off_t)sizeof(header))
+            {
+                rows = -1;
+                break;
+            }
+            memcpy(&header, data + offset, sizeof(header));
+
+            if (header.magic != BLOCK_MAGIC || header.float_columns != IVT490State_number_of_float_fields ||
+                header.bool_columns != IVT490State_number_of_bool_fields || header.size != block_size(header.rows) ||
+                header.size > info.st_size - offset)
+            {
+                rows = -1;
+                break;
+            }
+
+            handler(header, data + offset + sizeof(header));
+            rows += header.rows;
+            offset += header.size;
+        }
+
+        munmap(const_cast<char *>(data), info.st_size);
+        return rows;
+    }
+
+    struct Statistics
+    {
+        size_t messages = 0;
+        size_t payload_bytes = 0;
+        size_t duplicates = 0;  // Same payload as the previous message of the unit on the same topic
+        size_t malformed = 0;
+        size_t unchanged = 0;   // Parsed into the same state as already held
+        size_t downsampled = 0; // Replaced by a later change within the same interval
+        size_t rows = 0;
+        size_t units = 0;
+
+        void add(const Statistics &other)
+        {
+            this->messages += other.messages;
+            this->payload_bytes += other.payload_bytes;
+            this->duplicates += other.duplicates;
+            this->malformed += other.malformed;
+            this->unchanged += other.unchanged;
+            this->downsampled += other.downsampled;
+            this->rows += other.rows;
+            this->units += other.units;
+        }
+    };
+
+    // The Gateway runs the pipeline: messages are routed by unit to one of the workers, each owning the state
+    // of its units, where they are deduplicated, parsed and downsampled into rows. Full blocks of rows are
+    // written by a separate thread. As a unit always goes to the same worker, its messages stay in order.
+    //
+    // Every unit holds its latest state and writes it as a row at most once per interval, stamped with the
+    // start of the interval, and only for intervals in which the state changed. The columns are thereby
+    // to be read as sample and hold. With a clock, in the time of the messages, the row of a unit is written
+    // once its interval has passed, also when the unit goes quiet. Without, it waits for the next change or
+    // the end of the input.
+
+    class Gateway
+    {
+    public:
+        typedef int64_t (*Clock)();
+
+        Gateway(unsigned int threads, int64_t interval, Storage *storage, Clock clock = nullptr,
+                std::chrono::milliseconds flush_period = FLUSH_PERIOD) : blocks(QUEUE_CAPACITY / BLOCK_ROWS)
+        {
+            this->interval = interval;
+            this->storage = storage;
+            this->clock = clock;
+            this->flush_period = flush_period;
+
+            for (unsigned int t = 0; t < threads; t++)
+            {
+                this->workers.emplace_back(new Worker());
+            }
+            for (auto &worker : this->workers)
+            {
+                worker->thread = std::thread(&Gateway::work, this, worker.get());
+            }
+            this->writer = std::thread(&Gateway::write, this);
+        }
+
+        // Takes all messages, routing each to the worker of its unit
+        void publish(std::vector<Message> &messages)
+        {
+            std::vector<std::vector<Message>> parts(this->workers.size());
+            for (auto &message : messages)
+            {
+                parts[std::hash<std::string>()(message.unit) % parts.size()].push_back(std::move(message));
+            }
+            messages.clear();
+
+            for (size_t i = 0; i < parts.size(); i++)
+            {
+                if (!parts[i].empty())
+                {
+                    this->workers[i]->queue.push(parts[i]);
+                }
+            }
+        }
+
+        // Writes everything still held and stops the pipeline
+        Statistics finish()
+        {
+            for (auto &worker : this->workers)
+            {
+                worker->queue.close();
+            }
+
+            Statistics statistics;
+            for (auto &worker : this->workers)
+            {
+                worker->thread.join();
+                statistics.add(worker->statistics);
+            }
+
+            this->blocks.close();
+            this->writer.join();
+
+            return statistics;
+        }
+
+    private:
+        struct Unit
+        {
+            uint64_t hashes[NUMBER_OF_KINDS] = {};
+            IVT490State state = {};
+            bool has_state = false;
+            bool pending = false; // The state has changed since the last row
+            int64_t interval = 0; // Of the last change
+            Block block;
+        };
+
+        struct Worker
+        {
+            Queue<Message> queue{QUEUE_CAPACITY};
+            std::thread thread;
+            std::unordered_map<std::string, Unit> units;
+            Statistics statistics;
+        };
+
+        void work(Worker *worker)
+        {
+            std::vector<Message> messages;
+            auto last_flush = std::chrono::steady_clock::now();
+
+            while (worker->queue.pop_all(messages, this->flush_period))
+            {
+                for (auto &message : messages)
+                {
+                    this->process(*worker, message);
+                }
+
+                if (std::chrono::steady_clock::now() - last_flush >= this->flush_period)
+                {
+                    auto interval = this->clock ? this->clock() / this->interval : 0;
+                    for (auto &[name, unit] : worker->units)
+                    {
+                        if (this->clock && unit.pending && unit.interval < interval)
+                        {
+                            this->emit(*worker, unit);
+                        }
+                        this->flush(unit);
+                    }
+                    last_flush = std::chrono::steady_clock::now();
+                }
+            }
+
+            for (auto &[name, unit] : worker->units)
+            {
+                if (unit.pending)
+                {
+                    this->emit(*worker, unit);
+                }
+                this->flush(unit);
+            }
+            worker->statistics.units = worker->units.size();
+        }
+
+        void process(Worker &worker, Message &message)
+        {
+            auto &statistics = worker.statistics;
+            statistics.messages++;
+            statistics.payload_bytes += message.payload.size();
+
+            auto [entry, is_new] = worker.units.try_emplace(message.unit);
+            auto &unit = entry->second;
+            if (is_new)
+            {
+                unit.block.unit = message.unit;
+                unit.state.GT2_sensor = NAN; // Only part of the state blob
+            }
+
+            auto hash = fnv1a(message.payload);
+            if (unit.hashes[message.kind] == hash)
+            {
+                statistics.duplicates++;
+                return;
+            }
+            unit.hashes[message.kind] = hash;
+
+            auto sample = unit.state;
+            if (message.kind == RAW ? parse_IVT490(message.payload.c_str(), sample) < 0 : !parse_state(message.payload, sample))
+            {
+                statistics.malformed++;
+                return;
+            }
+
+            // The raw sentence and the state blob of the same sentence mostly carry the same values
+            if (unit.has_state && equal(sample, unit.state))
+            {
+                statistics.unchanged++;
+                return;
+            }
+
+            auto interval = message.time / this->interval;
+            if (unit.pending && interval != unit.interval)
+            {
+                this->emit(worker, unit);
+            }
+            else if (unit.pending)
+            {
+                statistics.downsampled++;
+            }
+
+            unit.state = sample;
+            unit.has_state = true;
+            unit.pending = true;
+            unit.interval = interval;
+        }
+
+        void emit(Worker &worker, Unit &unit)
+        {
+            unit.block.append(unit.interval * this->interval, unit.state);
+            unit.pending = false;
+            worker.statistics.rows++;
+
+            if (unit.block.rows() >= BLOCK_ROWS)
+            {
+                this->flush(unit);
+            }
+        }
+
+        void flush(Unit &unit)
+        {
+            if (unit.block.rows() == 0)
+            {
+                return;
+            }
+
+            std::vector<Block> blocks(1);
+            std::swap(blocks[0], unit.block);
+            unit.block.unit = blocks[0].unit;
+            this->blocks.push(blocks);
+        }
+
+        void write()
+        {
+            std::vector<Block> blocks;
+            while (this->blocks.pop_all(blocks, this->flush_period))
+            {
+                for (auto &block : blocks)
+                {
+                    if (this->storage)
+                    {
+                        this->storage->write(block);
+                    }
+                }
+            }
+        }
+
+        int64_t interval; // milliseconds
+        Storage *storage;
+        Clock clock;
+        std::chrono::milliseconds flush_period;
+        std::vector<std::unique_ptr<Worker>> workers;
+        Queue<Block> blocks;
+        std::thread writer;
+    };
+
+    // Milliseconds since the epoch, as the messages read from stdin are stamped
+    int64_t system_clock()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // Reads `mosquitto_sub -v` output, i.e. one "topic payload" per line, from stdin until end of input.
+    // Messages are passed on as read, every read() of stdin making a batch.
+    void run_stdin(Gateway &gateway)
+    {
+        std::vector<Message> messages;
+        std::string pending;
+        char buffer[1 << 16];
+
+        ssize_t length;
+        while ((length = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0)
+        {
+            pending.append(buffer, length);
+            auto time = system_clock();
+
+            size_t begin = 0;
+            for (size_t end; (end = pending.find('\n', begin)) != std::string::npos; begin = end + 1)
+            {
+                auto space = pending.find(' ', begin);
+                if (space == std::string::npos || space > end)
+                {
+                    continue;
+                }
+
+                Message message;
+                if (classify(pending.data() + begin, space - begin, message))
+                {
+                    message.payload.assign(pending, space + 1, end - space - 1);
+                    message.time = time;
+                    messages.push_back(std::move(message));
+                }
+            }
+            pending.erase(0, begin);
+
+            gateway.publish(messages);
+        }
+    }
+
+    // In-process stand-in for the broker, delivering what the given number of simulated units publish on
+    // their /state/raw and /state topics every publish interval, as fast as the gateway takes it. Each
+    // producer thread simulates a share of the units, stepping a virtual clock.
+    class FakeBroker
+    {
+    public:
+        static const int64_t PUBLISH_INTERVAL = 10000; // milliseconds, GENERAL_STATE_PUBLISH_INTERVAL
+
+        FakeBroker(unsigned int units, unsigned int producers)
+        {
+            this->units = units;
+            this->producers = producers;
+        }
+
+        void run(Gateway &gateway, int64_t duration)
+        {
+            std::vector<std::thread> threads;
+            for (unsigned int p = 0; p < this->producers; p++)
+            {
+                threads.emplace_back([&, p]()
+                                     { this->produce(gateway, duration, this->units * p / this->producers, this->units * (p + 1) / this->producers); });
+            }
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        size_t get_messages() const
+        {
+            return this->messages;
+        }
+
+    private:
+        struct SimulatedUnit
+        {
+            std::string topic;
+            int32_t items[IVT490_NO_OF_ITEMS_IN_SENTENCE];
+            float GT2_sensor;
+        };
+
+        void produce(Gateway &gateway, int64_t duration, unsigned int first, unsigned int last)
+        {
+            uint32_t seed = first + 1;
+            auto random = [&](int range)
+            {
+                seed = seed * 1664525 + 1013904223;
+                return (int)((seed >> 8) % range);
+            };
+
+            std::vector<SimulatedUnit> units(last - first);
+            for (unsigned int i = 0; i < units.size(); i++)
+            {
+                auto &unit = units[i];
+                unit.topic = "fleet/unit" + std::to_string(first + i);
+                std::fill(std::begin(unit.items), std::end(unit.items), 0);
+                const int temperatures[] = {0, 350, -50, 500, 480, 400, 210, 700, 0};
+                std::copy(std::begin(temperatures), std::end(temperatures), unit.items);
+                unit.items[20] = 200;
+                unit.items[21] = 220;
+                unit.items[22] = 380;
+                unit.items[23] = 550;
+                unit.GT2_sensor = -5;
+            }
+
+            std::vector<Message> messages;
+            char line[512];
+            size_t produced = 0;
+
+            for (int64_t time = 0; time < duration; time += PUBLISH_INTERVAL)
+            {
+                for (auto &unit : units)
+                {
+                    // Most sentences are the same as the last, now and then a temperature or a flag changes
+                    if (random(4) == 0)
+                    {
+                        unit.items[1 + random(7)] += random(5) - 2;
+                    }
+                    if (random(30) == 0)
+                    {
+                        unit.items[9 + random(11)] ^= 1;
+                    }
+                    if (random(10) == 0)
+                    {
+                        unit.GT2_sensor += (random(5) - 2) * 0.01;
+                    }
+
+                    auto length = 0;
+                    for (int item = 0; item < IVT490_NO_OF_ITEMS_IN_SENTENCE; item++)
+                    {
+                        length += snprintf(line + length, sizeof(line) - length, item ? ";%d" : "%d", unit.items[item]);
+                    }
+                    messages.push_back({unit.topic, RAW, std::string(line, length), time});
+
+                    IVT490State state = {};
+                    parse_IVT490(line, state);
+                    state.GT2_sensor = roundf(unit.GT2_sensor * 100) / 100;
+                    messages.push_back({unit.topic, STATE, this->serialize(state), time});
+                }
+
+                produced += messages.size();
+                gateway.publish(messages);
+            }
+
+            this->messages += produced;
+        }
+
+        // As serialize_IVT490State and ArduinoJson on the device
+        std::string serialize(const IVT490State &state)
+        {
+            std::string json = "{";
+            char item[64];
+
+            for (int i = 0; i < IVT490State_number_of_float_fields; i++)
+            {
+                snprintf(item, sizeof(item), "%s\"%s\":%g", i ? "," : "", IVT490State_float_fields[i].name, state.*IVT490State_float_fields[i].member);
+                json += item;
+            }
+            for (int i = 0; i < IVT490State_number_of_bool_fields; i++)
+            {
+                snprintf(item, sizeof(item), ",\"%s\":%s", IVT490State_bool_fields[i].name, state.*IVT490State_bool_fields[i].member ? "true" : "false");
+                json += item;
+            }
+
+            return json + "}";
+        }
+
+        unsigned int units;
+        unsigned int producers;
+        std::atomic<size_t> messages{0};
+    };
+
+    // Prints a unit file as CSV
+    int dump(const char *path)
+    {
+        printf("time");
+        for (int i = 0; i < IVT490State_number_of_float_fields; i++)
+        {
+            printf(",%s", IVT490State_float_fields[i].name);
+        }
+        for (int i = 0; i < IVT490State_number_of_bool_fields; i++)
+        {
+            printf(",%s", IVT490State_bool_fields[i].name);
+        }
+        printf("\n");
+
+        auto rows = scan(path, [](const BlockHeader &header, const char *data)
+                         {
+                             auto floats = data + header.rows * sizeof(int64_t);
+                             auto bools = floats + header.rows * header.float_columns * sizeof(float);
+
+                             for (uint32_t row = 0; row < header.rows; row++)
+                             {
+                                 int64_t time;
+                                 memcpy(&time, data + row * sizeof(int64_t), sizeof(time));
+                                 printf("%lld", (long long)time);
+
+                                 for (int i = 0; i < header.float_columns; i++)
+                                 {
+                                     float value;
+                                     memcpy(&value, floats + (i * header.rows + row) * sizeof(float), sizeof(value));
+                                     printf(",%g", value);
+                                 }
+                                 for (int i = 0; i < header.bool_columns; i++)
+                                 {
+                                     printf(",%d", bools[i * header.rows + row]);
+                                 }
+                                 printf("\n");
+                             } });
+
+        if (rows < 0)
+        {
+            fprintf(stderr, "Failed reading %s\n", path);
+            return 1;
+        }
+        return 0;
+    }
+
+    // Feeds a single message under a virtual clock and checks that its row is written once its interval has
+    // passed, without waiting for another message or the end of the input
+    int64_t self_test_time = 0;
+
+    int self_test()
+    {
+        char directory[] = "/tmp/ivt490-gateway-test-XXXXXX";
+        if (!mkdtemp(directory))
+        {
+            fprintf(stderr, "Self test: Failed creating a directory in /tmp\n");
+            return 1;
+        }
+
+        const int64_t INTERVAL = 60000;
+        Storage storage(directory);
+        Gateway gateway(1, INTERVAL, &storage, []()
+                        { return self_test_time; }, std::chrono::milliseconds(10));
+
+        auto path = storage.path("test/unit");
+        auto rows_within = [&](std::chrono::milliseconds timeout)
+        {
+            long rows = 0;
+            auto end = std::chrono::steady_clock::now() + timeout;
+            while (rows == 0 && std::chrono::steady_clock::now() < end)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                rows = std::max(0L, scan(path.c_str(), [](const BlockHeader &, const char *) {}));
+            }
+            return rows;
+        };
+
+        std::vector<Message> messages = {{"test/unit", RAW, "0;320;-47;480;500;350;210;700;0;0;0;0;0;0;0;0;1;0;0;0;200;220;320;550;0;0;0;0;0;0;0;0;0;0;0;0;0", 1000}};
+        self_test_time = 1000;
+        gateway.publish(messages);
+
+        int status = 0;
+        auto early = rows_within(std::chrono::milliseconds(100));
+        if (early != 0)
+        {
+            fprintf(stderr, "Self test: %ld rows written within the interval, expected none\n", early);
+            status = 1;
+        }
+
+        self_test_time = INTERVAL;
+        auto rows = rows_within(std::chrono::seconds(2));
+        if (rows != 1)
+        {
+            fprintf(stderr, "Self test: %ld rows written once the interval passed, expected 1\n", rows);
+            status = 1;
+        }
+
+        auto statistics = gateway.finish();
+        rows = scan(path.c_str(), [](const BlockHeader &, const char *) {});
+        if (statistics.rows != 1 || rows != 1)
+        {
+            fprintf(stderr, "Self test: %zu rows emitted, %ld read back after finishing, expected 1\n", statistics.rows, rows);
+            status = 1;
+        }
+
+        unlink(path.c_str());
+        rmdir(directory);
+
+        printf("Self test %s\n", status ? "FAILED" : "passed");
+        return status;
+    }
+
+    void usage(const char *program)
+    {
+        fprintf(stderr,
+                "Usage: %s [--threads N] [--interval SECONDS] [--output DIRECTORY]\n"
+                "       %s --load-test UNITS [--hours H] [--producers N] [--threads N] [--interval SECONDS] [--output DIRECTORY]\n"
+                "       %s --dump FILE\n"
+                "       %s --self-test\n",
+                program, program, program, program);
+        exit(1);
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+    unsigned int producers = std::max(1u, std::thread::hardware_concurrency() / 2);
+    int64_t interval = 60000;
+    const char *directory = nullptr;
+    unsigned int load_test_units = 0;
+    double load_test_hours = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--threads" && i + 1 < argc)
+        {
+            threads = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--interval" && i + 1 < argc)
+        {
+            interval = std::max(1LL, (long long)(atof(argv[++i]) * 1000));
+        }
+        else if (arg == "--output" && i + 1 < argc)
+        {
+            directory = argv[++i];
+        }
+        else if (arg == "--load-test" && i + 1 < argc)
+        {
+            load_test_units = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--hours" && i + 1 < argc)
+        {
+            load_test_hours = atof(argv[++i]);
+        }
+        else if (arg == "--producers" && i + 1 < argc)
+        {
+            producers = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--dump" && i + 1 < argc)
+        {
+            return dump(argv[++i]);
+        }
+        else if (arg == "--self-test")
+        {
+            return self_test();
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+
+    Storage *storage = directory ? new Storage(directory) : nullptr;
+    // The load test runs on the virtual time of the fake broker, so its rows wait for the next change
+    Gateway gateway(threads, interval, storage, load_test_units > 0 ? nullptr : system_clock);
+    FakeBroker broker(load_test_units, producers);
+
+    auto start = std::chrono::steady_clock::now();
+    if (load_test_units > 0)
+    {
+        broker.run(gateway, (int64_t)(load_test_hours * 3600000));
+    }
+    else
+    {
+        run_stdin(gateway);
+    }
+    auto statistics = gateway.finish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%zu messages (%zu bytes) from %zu units in %.3f s using %u threads\n",
+           statistics.messages, statistics.payload_bytes, statistics.units, seconds, threads);
+    printf("%zu duplicates, %zu unchanged, %zu downsampled, %zu malformed, %zu rows written\n",
+           statistics.duplicates, statistics.unchanged, statistics.downsampled, statistics.malformed, statistics.rows);
+    printf("%.0f messages/s\n", statistics.messages / seconds);
+
+    if (storage)
+    {
+        printf("%zu blocks, %zu bytes written (%.1f%% of the payloads)\n",
+               storage->blocks, storage->bytes, 100.0 * storage->bytes / std::max<size_t>(1, statistics.payload_bytes));
+    }
+
+    int status = 0;
+    if (load_test_units > 0)
+    {
+        auto expected = broker.get_messages();
+        if (statistics.messages != expected || statistics.units != load_test_units)
+        {
+            fprintf(stderr, "Load test: %zu of %zu messages from %zu of %u units arrived\n", statistics.messages, expected, statistics.units, load_test_units);
+            status = 1;
+        }
+
+        // Reading every unit file back must give exactly the rows written
+        if (storage)
+        {
+            size_t rows = 0;
+            for (unsigned int i = 0; i < load_test_units; i++)
+            {
+                auto path = storage->path("fleet/unit" + std::to_string(i));
+                auto unit_rows = scan(path.c_str(), [](const BlockHeader &, const char *) {});
+                if (unit_rows < 0)
+                {
+                    fprintf(stderr, "Load test: Failed reading %s\n", path.c_str());
+                    status = 1;
+                }
+                rows += std::max(0L, unit_rows);
+            }
+
+            if (rows != statistics.rows)
+            {
+                fprintf(stderr, "Load test: %zu rows read back, %zu written\n", rows, statistics.rows);
+                status = 1;
+            }
+        }
+
+        printf("Load test %s\n", status ? "FAILED" : "passed");
+    }
+
+    delete storage;
+    return status;
+}
@@ -0,0 +1,661 @@
+// Host replay harness for the controller of the IVT490 interface, see README.md
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include <ArduinoJson.h>
+
+// The example configuration of include/README.md in replay mode, override with -D to replay another
+#define GENERAL_REPLAY_MODE
+#ifndef MQTT_BASE_TOPIC
+#define MQTT_BASE_TOPIC "ivt490"
+#endif
+#ifndef GENERAL_CONTROL_VALUES_VALIDITY
+#define GENERAL_CONTROL_VALUES_VALIDITY 360 * 1000
+#endif
+#ifndef GENERAL_STATE_PUBLISH_INTERVAL
+#define GENERAL_STATE_PUBLISH_INTERVAL 10000
+#endif
+#ifndef GENERAL_JSON_DOCUMENT_SIZE
+// As many members as on the device, where ArduinoJson takes 16 bytes per member rather than the 32 of a 64 bit host
+#define GENERAL_JSON_DOCUMENT_SIZE (4096 / 16 * JSON_OBJECT_SIZE(1))
+#endif
+#ifndef IVT490_HEATING_CURVE_SLOPE
+#define IVT490_HEATING_CURVE_SLOPE 3.0
+#endif
+#ifndef IVT490_ADC_CS
+#define IVT490_ADC_CS 15
+#endif
+#ifndef IVT490_ADC_R0
+#define IVT490_ADC_R0 10000
+#endif
+#ifndef IVT490_ADC_SAMPLING_MIN_INTERVAL
+#define IVT490_ADC_SAMPLING_MIN_INTERVAL 1000
+#endif
+#ifndef IVT490_ADC_FILTER_TIME_CONSTANT
+#define IVT490_ADC_FILTER_TIME_CONSTANT 300000
+#endif
+#ifndef IVT490_DIGIPOT_CS
+#define IVT490_DIGIPOT_CS 2
+#endif
+#ifndef IVT490_DIGPOT_RESOLUTION
+#define IVT490_DIGPOT_RESOLUTION 8
+#endif
+#ifndef IVT490_DIGIPOT_MAX_RESISTANCE
+#define IVT490_DIGIPOT_MAX_RESISTANCE 100000
+#endif
+#ifndef IVT490_CONTROL_INTERVAL
+#define IVT490_CONTROL_INTERVAL 1000
+#endif
+#ifndef IVT490_INDOOR_TEMPERATURE_FEEDBACK_CONTROL_WEIGHT
+#define IVT490_INDOOR_TEMPERATURE_FEEDBACK_CONTROL_WEIGHT 10
+#endif
+#ifndef IVT490_SUMMER_TEMPERATURE_LIMIT
+#define IVT490_SUMMER_TEMPERATURE_LIMIT 14.0
+#endif
+
+#include "config_defaults.h"
+
+#include "Scheduler.h"
+#include "Interface.h"
+
+namespace
+{
+    // Lines of output, in the order they happen: published messages and changes of the wiper and the relay
+    std::vector<std::string> output;
+
+    // The virtual clock, in milliseconds since boot
+    unsigned long now = 0;
+
+    unsigned long virtual_clock()
+    {
+        return now;
+    }
+
+    void emit(const char *kind, const std::string &text)
+    {
+        output.push_back(std::to_string(now) + " " + kind + " " + text);
+    }
+
+    // Stands in for AsyncMqttClient and the broker: delivers messages on the subscribed topics and records
+    // whatever is published
+    class MockBroker
+    {
+    public:
+        typedef void (*Handler)(const char *topic, const char *payload, size_t length);
+
+        void on_message(Handler handler)
+        {
+            this->handler = handler;
+        }
+
+        uint16_t subscribe(const char *topic, uint8_t qos)
+        {
+            this->subscriptions.push_back(topic);
+            return 0;
+        }
+
+        uint16_t publish(const char *topic, uint8_t qos, bool retain, const char *payload)
+        {
+            this->published++;
+            emit("publish", std::string(topic) + " " + payload);
+            return 0;
+        }
+
+        void deliver(const std::string &topic, const std::string &payload)
+        {
+            if (std::find(this->subscriptions.begin(), this->subscriptions.end(), topic) == this->subscriptions.end())
+            {
+                this->unsubscribed++;
+                return;
+            }
+
+            this->delivered++;
+            this->handler(topic.c_str(), payload.data(), payload.size());
+        }
+
+        size_t get_delivered() const
+        {
+            return this->delivered;
+        }
+
+        size_t get_unsubscribed() const
+        {
+            return this->unsubscribed;
+        }
+
+        size_t get_published() const
+        {
+            return this->published;
+        }
+
+    private:
+        Handler handler = nullptr;
+        std::vector<std::string> subscriptions;
+        size_t delivered = 0;
+        size_t unsubscribed = 0;
+        size_t published = 0;
+    };
+
+    // Stand-ins for MCP3208 and MCP41_Simple, the ADC reads the last code of the capture
+    struct ReplayedADC
+    {
+        int value = -1;
+
+        void begin(uint8_t CS_pin) {}
+
+        int analogRead(uint8_t channel)
+        {
+            return this->value;
+        }
+
+        int maxValue()
+        {
+            return 4095;
+        }
+    };
+
+    struct RecordingPot
+    {
+        int wiper = -1;
+
+        void begin(uint8_t CS_pin) {}
+
+        void setWiper(uint8_t value)
+        {
+            if (value != this->wiper)
+            {
+                this->wiper = value;
+                emit("wiper", std::to_string(value));
+            }
+        }
+    };
+
+    // Stands in for Snapshot::Store and Snapshot::FileStore, keeping the copies in memory. Nothing is
+    // restored on boot, as on a device without a snapshot.
+    template <typename payload_t>
+    class MemoryStore
+    {
+    public:
+        MemoryStore(const char *path) {}
+
+        void save_to_rtc(const payload_t &payload)
+        {
+            this->rtc = payload;
+            this->rtc_saves++;
+        }
+
+        void save_to_flash(const payload_t &payload)
+        {
+            this->flash = payload;
+            this->flash_saves++;
+        }
+
+        bool load_from_flash(payload_t &payload)
+        {
+            if (this->flash_saves == 0)
+            {
+                return false;
+            }
+            payload = this->flash;
+            return true;
+        }
+
+        Snapshot::Source load(payload_t &payload)
+        {
+            if (this->rtc_saves > 0)
+            {
+                payload = this->rtc;
+                return Snapshot::Source::RTC;
+            }
+            return this->load_from_flash(payload) ? Snapshot::Source::FLASH : Snapshot::Source::NONE;
+        }
+
+        size_t get_rtc_saves() const
+        {
+            return this->rtc_saves;
+        }
+
+        size_t get_flash_saves() const
+        {
+            return this->flash_saves;
+        }
+
+    private:
+        payload_t rtc;
+        payload_t flash;
+        size_t rtc_saves = 0;
+        size_t flash_saves = 0;
+    };
+
+    int relay = -1;
+
+    void write_relay(bool on)
+    {
+        if (on != relay)
+        {
+            relay = on;
+            emit("relay", std::to_string(relay));
+        }
+    }
+
+    // The same interface as run by the firmware, in replay mode
+    MockBroker broker;
+    Scheduler::Scheduler<4> scheduler(virtual_clock);
+    Interface::Interface<MockBroker, ReplayedADC, RecordingPot, MemoryStore<Interface::PersistedState>, MemoryStore<Interface::PersistedAccounting>> ivt490(broker, virtual_clock, write_relay);
+
+    // As src/main.cpp, with the ADC and without the connection handling, metrics, heap diagnostics and daily restart
+    void setup()
+    {
+        broker.on_message([](const char *topic, const char *payload, size_t length)
+                          { ivt490.handle_message(topic, payload, length); });
+
+        ivt490.on_diagnostics([](JsonDocument &doc)
+                              { scheduler.serialize(doc.createNestedObject("scheduler")); });
+        ivt490.get_anomaly_detector().on_anomaly([](const char *channel, const char *kind, bool active, float value, float expected)
+                                                 { ivt490.publish_anomaly(channel, kind, active, value, expected); });
+        ivt490.begin(MQTT_BASE_TOPIC);
+        ivt490.subscribe();
+
+        // Only sampled once the capture has given an ADC code
+        scheduler.add("adc", IVT490_ADC_SAMPLING_MIN_INTERVAL, 1, []()
+                      { return ivt490.get_GT2_reader().get_adc().value < 0 || ivt490.sample(); });
+
+        scheduler.add("control", IVT490_CONTROL_INTERVAL, 0, []()
+                      { return ivt490.control(); });
+
+        scheduler.add("publish", GENERAL_STATE_PUBLISH_INTERVAL, 2, []()
+                      { return ivt490.publish_chunk(); });
+
+        scheduler.add("snapshot", GENERAL_SNAPSHOT_INTERVAL, 3, []()
+                      {
+                          ivt490.save_to_flash();
+                          return true; });
+    }
+
+    // The earliest time at which a task is due, or is to continue its work
+    unsigned long next_due()
+    {
+        auto due = scheduler.get_task(0).due;
+        for (unsigned int i = 0; i < scheduler.get_number_of_tasks(); i++)
+        {
+            auto &task = scheduler.get_task(i);
+            if (task.running)
+            {
+                return now;
+            }
+            if ((long)(task.due - due) < 0)
+            {
+                due = task.due;
+            }
+        }
+        return due;
+    }
+
+    // One line of a capture: TIME KIND REST, see README.md
+    struct Event
+    {
+        unsigned long time;
+        std::string kind;
+        std::string rest;
+    };
+
+    bool read_capture(const char *path, std::vector<Event> &events)
+    {
+        auto file = fopen(path, "r");
+        if (!file)
+        {
+            fprintf(stderr, "Failed opening %s\n", path);
+            return false;
+        }
+
+        char line[1024];
+        size_t number = 0;
+        while (fgets(line, sizeof(line), file))
+        {
+            number++;
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0' || line[0] == '#')
+            {
+                continue;
+            }
+
+            char *kind = strchr(line, ' ');
+            char *rest = kind ? strchr(kind + 1, ' ') : nullptr;
+            if (!rest)
+            {
+                fprintf(stderr, "%s:%zu: expected TIME KIND VALUE\n", path, number);
+                fclose(file);
+                return false;
+            }
+            *kind++ = '\0';
+            *rest++ = '\0';
+
+            Event event = {strtoul(line, nullptr, 10), kind, rest};
+            if (!events.empty() && event.time < events.back().time)
+            {
+                fprintf(stderr, "%s:%zu: time goes backwards\n", path, number);
+                fclose(file);
+                return false;
+            }
+            events.push_back(event);
+        }
+
+        fclose(file);
+        return true;
+    }
+
+    // Series resistance between the digipot and the heatpump, when the reading of GT2 by the heatpump is to
+    // follow the wiper rather than the capture. NAN when replaying the capture as is.
+    float closed_loop_resistance = NAN;
+
+    // Replaces GT2_heatpump in a sentence with what the heatpump would read through the digipot
+    std::string close_loop(const std::string &raw)
+    {
+        const float STEPS = 1 << IVT490_DIGPOT_RESOLUTION;
+        auto resistance = 125 /* WIPER_RESISTANCE */ + ivt490.get_GT2_emulator().get_pot().wiper / (STEPS - 1) * IVT490_DIGIPOT_MAX_RESISTANCE + closed_loop_resistance;
+        auto item = (int)lroundf(Thermistor::NTC_interpolate_temperature(resistance) * 10);
+
+        // GT2_heatpump is the third item
+        auto first = raw.find(';');
+        auto second = first == std::string::npos ? first : raw.find(';', first + 1);
+        auto third = second == std::string::npos ? second : raw.find(';', second + 1);
+        if (third == std::string::npos)
+        {
+            return raw;
+        }
+        return raw.substr(0, second + 1) + std::to_string(item) + raw.substr(third);
+    }
+
+    void deliver(const Event &event)
+    {
+        if (event.kind == "raw")
+        {
+            broker.deliver(MQTT_BASE_TOPIC "/replay/raw", isnan(closed_loop_resistance) ? event.rest : close_loop(event.rest));
+        }
+        else if (event.kind == "GT2_sensor")
+        {
+            broker.deliver(MQTT_BASE_TOPIC "/replay/GT2_sensor", event.rest);
+        }
+        else if (event.kind == "adc")
+        {
+            ivt490.get_GT2_reader().get_adc().value = atoi(event.rest.c_str());
+        }
+        else if (event.kind == "mqtt")
+        {
+            auto space = event.rest.find(' ');
+            broker.deliver(event.rest.substr(0, space), space == std::string::npos ? "" : event.rest.substr(space + 1));
+        }
+    }
+
+    // Runs the capture under the virtual clock, jumping from one event or due task to the next
+    void run(const std::vector<Event> &events, unsigned long end)
+    {
+        size_t next = 0;
+
+        while (true)
+        {
+            auto due = next_due();
+            auto time = next < events.size() ? std::min(events[next].time, due) : due;
+            if (time > end)
+            {
+                break;
+            }
+            now = std::max(now, time);
+
+            while (next < events.size() && events[next].time <= now)
+            {
+                deliver(events[next++]);
+            }
+
+            while ((long)(now - next_due()) >= 0)
+            {
+                scheduler.tick();
+            }
+        }
+
+        now = end;
+    }
+
+    // Compares the output to a golden file, reporting the first difference
+    bool compare(const char *path)
+    {
+        auto file = fopen(path, "r");
+        if (!file)
+        {
+            fprintf(stderr, "Failed opening %s\n", path);
+            return false;
+        }
+
+        std::string line;
+        size_t number = 0;
+        bool equal = true;
+        int c;
+        do
+        {
+            c = fgetc(file);
+            if (c != '\n' && c != EOF)
+            {
+                line += (char)c;
+                continue;
+            }
+            if (c == EOF && line.empty())
+            {
+                break;
+            }
+
+            if (number >= output.size() || line != output[number])
+            {
+                printf("Mismatch at line %zu\n  golden: %s\n  replay: %s\n", number + 1, line.c_str(), number < output.size() ? output[number].c_str() : "(end of output)");
+                equal = false;
+                break;
+            }
+            number++;
+            line.clear();
+        } while (c != EOF);
+
+        if (equal && number < output.size())
+        {
+            printf("Mismatch at line %zu\n  golden: (end of file)\n  replay: %s\n", number + 1, output[number].c_str());
+            equal = false;
+        }
+
+        fclose(file);
+        return equal;
+    }
+
+    bool record(const char *path)
+    {
+        auto file = fopen(path, "w");
+        if (!file)
+        {
+            fprintf(stderr, "Failed opening %s\n", path);
+            return false;
+        }
+
+        for (auto &line : output)
+        {
+            fprintf(file, "%s\n", line.c_str());
+        }
+
+        return fclose(file) == 0;
+    }
+
+    // Writes a synthetic capture: a daily swing of the outdoor temperature read by the ADC, a sentence every
+    // minute, and an offset and indoor feedback now and then. GT2_heatpump is the outdoor temperature, meant to be
+    // replaced using --closed-loop.
+    bool generate(double hours, const char *path)
+    {
+        auto file = fopen(path, "w");
+        if (!file)
+        {
+            fprintf(stderr, "Failed opening %s\n", path);
+            return false;
+        }
+
+        const unsigned long DAY = 24 * 3600000UL;
+        auto duration = (unsigned long)(hours * 3600000);
+        int last_code = -1;
+
+        fprintf(file, "# Synthetic capture, %g hours\n", hours);
+        for (unsigned long time = 1000; time <= duration; time += 1000)
+        {
+            float outdoor = -5 + 5 * sinf(2 * (float)M_PI * (time % DAY) / DAY);
+
+            auto resistance = Thermistor::NTC_interpolate_resistance(outdoor);
+            int code = (int)lroundf(4095 * IVT490_ADC_R0 / (resistance + IVT490_ADC_R0));
+            if (code != last_code)
+            {
+                fprintf(file, "%lu adc %d\n", time, code);
+                last_code = code;
+            }
+
+            if (time % 60000 == 0)
+            {
+                int items[IVT490_NO_OF_ITEMS_IN_SENTENCE] = {};
+                auto feed = HeatingCurve::heating_curve(IVT490_HEATING_CURVE_SLOPE, outdoor);
+                items[1] = (int)lroundf(feed * 10);
+                items[2] = (int)lroundf(outdoor * 10);
+                items[3] = 480;
+                items[4] = 500;
+                items[5] = (int)lroundf((feed + 3) * 10);
+                items[6] = 210;
+                items[7] = 700;
+                items[13] = (time / 1200000) % 3 != 0; // Compressor on two thirds of the time
+                items[16] = 1;
+                items[20] = 200;
+                items[21] = 220;
+                items[22] = (int)lroundf(feed * 10);
+                items[23] = 550;
+
+                fprintf(file, "%lu raw", time);
+                for (int item = 0; item < IVT490_NO_OF_ITEMS_IN_SENTENCE; item++)
+                {
+                    fprintf(file, item ? ";%d" : " %d", items[item]);
+                }
+                fprintf(file, "\n");
+            }
+
+            if (time % 300000 == 0)
+            {
+                fprintf(file, "%lu mqtt ivt490/controller/feedback/indoor_temperature %.1f\n", time, 20 + 0.5 * sinf(2 * (float)M_PI * time / 7200000));
+            }
+
+            if (time % DAY >= 6 * 3600000UL && time % DAY < 8 * 3600000UL && time % 300000 == 0)
+            {
+                fprintf(file, "%lu mqtt ivt490/controller/set/outdoor_temperature_offset 2\n", time);
+            }
+        }
+
+        return fclose(file) == 0;
+    }
+
+    void usage(const char *name)
+    {
+        fprintf(stderr, "Usage: %s CAPTURE [--closed-loop OHMS] [--until SECONDS] [--record FILE] [--golden FILE] [--print]\n", name);
+        fprintf(stderr, "       %s --generate HOURS FILE\n", name);
+        exit(2);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *capture = nullptr;
+    const char *record_path = nullptr;
+    const char *golden_path = nullptr;
+    bool print = false;
+    double until = -1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--generate" && i + 2 < argc)
+        {
+            return generate(atof(argv[i + 1]), argv[i + 2]) ? 0 : 1;
+        }
+        else if (arg == "--closed-loop" && i + 1 < argc)
+        {
+            closed_loop_resistance = atof(argv[++i]);
+        }
+        else if (arg == "--until" && i + 1 < argc)
+        {
+            until = atof(argv[++i]);
+        }
+        else if (arg == "--record" && i + 1 < argc)
+        {
+            record_path = argv[++i];
+        }
+        else if (arg == "--golden" && i + 1 < argc)
+        {
+            golden_path = argv[++i];
+        }
+        else if (arg == "--print")
+        {
+            print = true;
+        }
+        else if (arg[0] != '-' && !capture)
+        {
+            capture = argv[i];
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+
+    if (!capture)
+    {
+        usage(argv[0]);
+    }
+
+    std::vector<Event> events;
+    if (!read_capture(capture, events))
+    {
+        return 1;
+    }
+
+    // Runs until the last event, and one publish interval beyond it to see its effect
+    auto end = until >= 0 ? (unsigned long)(until * 1000) : (events.empty() ? 0 : events.back().time) + GENERAL_STATE_PUBLISH_INTERVAL;
+
+    auto start = std::chrono::steady_clock::now();
+    setup();
+    run(events, end);
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (print)
+    {
+        for (auto &line : output)
+        {
+            printf("%s\n", line.c_str());
+        }
+    }
+
+    auto hours = end / 3600000.0;
+    fprintf(stderr, "Replayed %zu events, %.2f simulated hours in %.3f s, %.0f simulated hours/s\n", events.size(), hours, seconds, hours / seconds);
+    fprintf(stderr, "Broker: %zu delivered, %zu not subscribed, %zu published. Snapshots: %zu to RTC memory, %zu to flash. Output: %zu lines\n", broker.get_delivered(), broker.get_unsubscribed(), broker.get_published(),
+            ivt490.get_snapshot().get_rtc_saves(), ivt490.get_snapshot().get_flash_saves(), output.size());
+
+    if (record_path && !record(record_path))
+    {
+        return 1;
+    }
+
+    if (golden_path)
+    {
+        if (!compare(golden_path))
+        {
+            return 1;
+        }
+        fprintf(stderr, "Output matches %s\n", golden_path);
+    }
+
+    return 0;
+}